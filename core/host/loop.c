@@ -0,0 +1,167 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "config.h"
+#include "core/debug.h"
+#include "core/host/loop.h"
+#include "core/host/stdin.h"
+#include "core/host/tap.h"
+
+/* Wall-clock (monotonic) time of the last timer() tick that has fired. */
+static struct timespec host_loop_last;
+
+/* Descriptors no longer polled after an error or hangup. */
+#define HOST_LOOP_STDIN	0x01
+#define HOST_LOOP_TAP	0x02
+static uint8_t host_loop_closed;
+
+static void
+timespec_add_ns (struct timespec *ts, int64_t ns)
+{
+  ns += ts->tv_nsec;
+  ts->tv_sec += ns / 1000000000L;
+  ts->tv_nsec = ns % 1000000000L;
+}
+
+static int64_t
+timespec_diff_ns (const struct timespec *a, const struct timespec *b)
+{
+  return (int64_t) (a->tv_sec - b->tv_sec) * 1000000000L
+    + (a->tv_nsec - b->tv_nsec);
+}
+
+void
+host_loop_init (void)
+{
+  clock_gettime (CLOCK_MONOTONIC, &host_loop_last);
+}
+
+static void
+host_loop_dispatch (struct pollfd *fds, int nfds)
+{
+  for (int i = 0; i < nfds; i ++)
+    {
+      short revents = fds[i].revents;
+
+#ifdef ECMD_PARSER_SUPPORT
+      if (fds[i].fd == 0)
+	{
+	  if (revents & POLLIN)
+	    stdin_read ();
+
+	  /* A stdin at end of file or hung up is reported ready on every
+	     ppoll(), stop polling it instead of spinning.  Input stdio has
+	     already buffered is still parsed. */
+	  if (feof (stdin) || (revents & (POLLERR | POLLNVAL))
+	      || (revents & (POLLIN | POLLHUP)) == POLLHUP)
+	    {
+	      while (!feof (stdin) && !ferror (stdin))
+		stdin_read ();
+	      debug_printf ("host loop: stdin closed\n");
+	      host_loop_closed |= HOST_LOOP_STDIN;
+	    }
+	}
+#endif
+
+#ifdef TAP_SUPPORT
+      if (fds[i].fd == tap_fd)
+	{
+	  if (revents & POLLIN)
+	    tap_read ();
+
+	  if (revents & (POLLERR | POLLHUP | POLLNVAL))
+	    {
+	      debug_printf ("host loop: tap device failed, revents=0x%x\n",
+			    revents);
+	      host_loop_closed |= HOST_LOOP_TAP;
+	    }
+	}
+#endif
+    }
+}
+
+uint16_t
+host_loop_wait (uint16_t ticks)
+{
+  struct pollfd fds[2];
+  int nfds = 0;
+
+#ifdef ECMD_PARSER_SUPPORT
+  if (!(host_loop_closed & HOST_LOOP_STDIN))
+    {
+      fds[nfds].fd = 0;
+      fds[nfds ++].events = POLLIN;
+    }
+#endif
+#ifdef TAP_SUPPORT
+  if (!(host_loop_closed & HOST_LOOP_TAP))
+    {
+      fds[nfds].fd = tap_fd;
+      fds[nfds ++].events = POLLIN;
+    }
+#endif
+
+  struct timespec deadline = host_loop_last, now;
+  timespec_add_ns (&deadline, (int64_t) ticks * HOST_LOOP_TICK_NS);
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  int64_t left = timespec_diff_ns (&deadline, &now);
+
+  /* Sleep until either I/O is ready or the deadline has passed.  If the
+     deadline is already over, still poll once so that pending input is
+     not starved while we are catching up on ticks. */
+  struct timespec timeout = { 0, 0 };
+  if (left > 0)
+    timespec_add_ns (&timeout, left);
+
+  int ret = ppoll (fds, nfds, &timeout, NULL);
+  if (ret > 0)
+    {
+      host_loop_dispatch (fds, nfds);
+      clock_gettime (CLOCK_MONOTONIC, &now);
+    }
+  else if (ret < 0 && errno != EINTR)
+    debug_printf ("host loop: ppoll failed, errno=%d\n", errno);
+  else if (left > 0)
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+  if (timespec_diff_ns (&now, &deadline) < 0)
+    return 0;			/* woken by I/O, nothing due yet */
+
+  if (timespec_diff_ns (&now, &deadline)
+      > (int64_t) HOST_LOOP_MAX_LAG * HOST_LOOP_TICK_NS)
+    {
+      debug_printf ("host loop: lagging behind, resynchronizing\n");
+      host_loop_last = now;
+    }
+  else
+    host_loop_last = deadline;
+
+  return ticks;
+}
+
+/*
+  -- Ethersex META --
+  header(core/host/loop.h)
+  initearly(host_loop_init)
+*/
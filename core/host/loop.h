@@ -0,0 +1,41 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#ifndef CORE_HOST_LOOP_H
+#define CORE_HOST_LOOP_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+/* Length of one timer() tick, i.e. 1/HZ seconds. */
+#define HOST_LOOP_TICK_NS	(1000000000L / 50)
+
+/* Scheduler milliticks per timer() tick. */
+#define HOST_LOOP_MTICKS	(CONF_MTICKS_PER_SEC / 50)
+
+/* If we are lagging behind by more than this many ticks (e.g. the process
+   has been stopped), resynchronize instead of firing all missed ticks. */
+#define HOST_LOOP_MAX_LAG	50
+
+void host_loop_init(void);
+
+/* Service stdin and the TAP device until `ticks' timer() ticks after the
+   last deadline have passed.  Returns the number of ticks that have become
+   due (i.e. `ticks') or zero if we returned early because of I/O. */
+uint16_t host_loop_wait(uint16_t ticks);
+
+#endif  /* CORE_HOST_LOOP_H */
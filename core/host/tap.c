@@ -27,6 +27,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include "config.h"
 #include "core/debug.h"
@@ -36,6 +37,7 @@
 #include "protocols/uip/uip_arp.h"
 
 int tap_fd;
+struct tap_stats_t tap_stats;
 
 #define die(a...) do { fprintf(stderr, a); exit (-1); } while(0)
 
@@ -85,6 +87,10 @@ open_tap(void)
   if (tap_fd < 0)
     die("Couldn't open tap device");
 
+  /* tap_read drains the device until EAGAIN */
+  if (fcntl(tap_fd, F_SETFL, fcntl(tap_fd, F_GETFL) | O_NONBLOCK) < 0)
+    die("Couldn't set tap device non-blocking");
+
 
 #ifdef IPV6_SUPPORT
   exec_cmd("ip -6 a a " CONF_TAP_LOCALIP "/%d dev %s", CONF_TAP_LOCALPLEN, tap_name);
@@ -95,12 +101,9 @@ open_tap(void)
 }
 
 
-void
-tap_read (void)
+static void
+tap_process (void)
 {
-  uip_stack_set_active(STACK_TAP);
-  uip_len = read (tap_fd, uip_buf, UIP_CONF_BUFFER_SIZE);
-
   /* process packet */
   struct uip_eth_hdr *packet = (struct uip_eth_hdr *)&uip_buf;
 
@@ -156,6 +159,39 @@ tap_read (void)
 }
 
 
+void
+tap_read (void)
+{
+  uint16_t frames = 0;
+
+  /* Process every frame that is already queued, but at most
+     CONF_TAP_RX_BUDGET of them, so timers and stdin are not starved
+     under a flood. */
+  while (frames < CONF_TAP_RX_BUDGET)
+    {
+      ssize_t len = read (tap_fd, uip_buf, UIP_CONF_BUFFER_SIZE);
+      if (len <= 0)
+	{
+	  if (len < 0 && errno != EAGAIN && errno != EINTR)
+	    debug_printf ("tap: read failed, errno=%d\n", errno);
+	  break;
+	}
+
+      uip_stack_set_active(STACK_TAP);
+      uip_len = len;
+      tap_process ();
+      frames ++;
+    }
+
+  tap_stats.wakeups ++;
+  tap_stats.frames += frames;
+  if (frames > tap_stats.batch_max)
+    tap_stats.batch_max = frames;
+  if (frames == CONF_TAP_RX_BUDGET)
+    tap_stats.budget_exhausted ++;
+}
+
+
 void
 tap_send (void)
 {
@@ -19,8 +19,18 @@
 #ifndef CORE_HOST_TAP_H
 #define CORE_HOST_TAP_H
 
+#include <stdint.h>
+
+struct tap_stats_t {
+  uint32_t wakeups;		/* calls of tap_read */
+  uint32_t frames;		/* frames received */
+  uint32_t budget_exhausted;	/* wakeups that hit CONF_TAP_RX_BUDGET */
+  uint16_t batch_max;		/* max. frames processed in one wakeup */
+};
+
 void open_tap(void);
 extern int tap_fd;
+extern struct tap_stats_t tap_stats;
 
 void tap_read(void);
 void tap_send(void);
@@ -0,0 +1,40 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+#include "config.h"
+#include "core/host/tap.h"
+
+#include "protocols/ecmd/ecmd-base.h"
+
+int16_t
+parse_cmd_tap_stats(char *cmd, char *output, uint16_t len)
+{
+  return ECMD_FINAL(snprintf_P(output, len,
+                               PSTR("wakeups %lu frames %lu max %u full %lu"),
+                               (unsigned long) tap_stats.wakeups,
+                               (unsigned long) tap_stats.frames,
+                               tap_stats.batch_max,
+                               (unsigned long) tap_stats.budget_exhausted));
+}
+
+/*
+  -- Ethersex META --
+  block(Network configuration)
+  ecmd_feature(tap_stats, "tap stats",, Show TAP receive statistics (wakeups, frames, max. frames per wakeup, wakeups hitting the budget).)
+*/
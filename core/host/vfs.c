@@ -21,6 +21,8 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include "core/vfs/vfs.h"
@@ -73,6 +75,20 @@ vfs_host_open (const char *filename)
   struct vfs_file_handle_t *fh = g_malloc (sizeof (struct vfs_file_handle_t));
   fh->fh_type = VFS_HOST;
   fh->u.host.fd = fd;
+  fh->u.host.map = NULL;
+
+  /* Map regular files, so that pread doesn't need a system call. */
+  struct stat st;
+  if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0
+      && (vfs_size_t) st.st_size == st.st_size)
+    {
+      void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED)
+	{
+	  fh->u.host.map = map;
+	  fh->u.host.map_len = st.st_size;
+	}
+    }
 
   return fh;
 }
@@ -80,6 +96,8 @@ vfs_host_open (const char *filename)
 void
 vfs_host_close (struct vfs_file_handle_t *fh)
 {
+  if (fh->u.host.map)
+    munmap (fh->u.host.map, fh->u.host.map_len);
   close (fh->u.host.fd);
   g_free (fh);
 }
@@ -90,11 +108,44 @@ vfs_host_read  (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
   return read (fh->u.host.fd, buf, length);
 }
 
-/* vfs_size_t 
-vfs_host_size (struct vfs_file_handle_t *)
+vfs_size_t
+vfs_host_pread (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length,
+		vfs_size_t offset)
 {
-  return 0;
-} */
+  if (fh->u.host.map == NULL)
+    {
+      ssize_t len = pread (fh->u.host.fd, buf, length, offset);
+      return len < 0 ? 0 : len;
+    }
+
+  if (offset >= fh->u.host.map_len)
+    return 0;
+  if (length > fh->u.host.map_len - offset)
+    length = fh->u.host.map_len - offset;
+
+  memcpy (buf, (char *) fh->u.host.map + offset, length);
+  return length;
+}
+
+uint32_t
+vfs_host_etag (struct vfs_file_handle_t *fh)
+{
+  struct stat st;
+  if (fstat (fh->u.host.fd, &st))
+    return 0;
+
+  return (uint32_t) st.st_mtime ^ (uint32_t) st.st_size << 8;
+}
+
+vfs_size_t
+vfs_host_size (struct vfs_file_handle_t *fh)
+{
+  struct stat st;
+  if (fstat (fh->u.host.fd, &st))
+    return 0;
+
+  return st.st_size;
+}
 
 uint8_t 
 vfs_host_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset, uint8_t whence)
@@ -24,6 +24,8 @@
 
 typedef struct {
   int fd;
+  void *map;			/* Whole file mapped, NULL if not possible. */
+  vfs_size_t map_len;
 } vfs_file_handle_host_t;
 
 /* vfs_sd_ Prototypes. */
@@ -34,6 +36,9 @@ vfs_size_t vfs_host_read  (struct vfs_file_handle_t *, void *buf,
 vfs_size_t vfs_host_size (struct vfs_file_handle_t *);
 uint8_t vfs_host_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
 			  uint8_t whence);
+vfs_size_t vfs_host_pread (struct vfs_file_handle_t *, void *buf,
+			   vfs_size_t length, vfs_size_t offset);
+uint32_t vfs_host_etag (struct vfs_file_handle_t *);
 
 
 #define VFS_HOST_FUNCS {		\
@@ -46,7 +51,9 @@ uint8_t vfs_host_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     NULL, /* truncate */		\
     NULL, /* create */			\
     NULL, /* unlink */			\
-    NULL, /* size */			\
+    vfs_host_size,			\
+    vfs_host_pread,			\
+    vfs_host_etag,			\
   }
 
 #endif  /* CORE_HOST_VFS_H */
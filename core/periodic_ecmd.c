@@ -21,12 +21,14 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <util/delay.h>
 
 #include "config.h"
 #include "protocols/ecmd/ecmd-base.h"
 #include "core/periodic.h"
+#include "core/periodic_stats.h"
 
 #ifdef PERIODIC_ADJUST_SUPPORT
 int16_t
@@ -143,6 +145,75 @@ parse_cmd_periodic_reset(char *cmd, char *output, uint16_t len)
 
 #endif /* DEBUG_PERIODIC_ECMD_SUPPORT */
 
+#ifdef PERIODIC_STATS_SUPPORT
+/* Next timer to print, skip dynamic timers that never ran. */
+static uint8_t
+periodic_timers_next(uint8_t i)
+{
+  for (; i < periodic_stats_max; i++)
+    if (i < periodic_stats_names_max || periodic_stats[i].runs)
+      break;
+
+  return i;
+}
+
+int16_t
+parse_cmd_periodic_timers(char *cmd, char *output, uint16_t len)
+{
+  char *p = cmd;
+
+  /* trick: use bytes on cmd as "connection specific static variables" */
+  if (cmd[0] != ECMD_STATE_MAGIC)
+  {
+    while (*p == ' ')
+      p++;
+
+    if (strcmp_P(p, PSTR("reset")) == 0)
+    {
+      periodic_stats_reset();
+      return ECMD_FINAL_OK;
+    }
+    if (*p)
+      return ECMD_ERR_PARSE_ERROR;
+
+    cmd[0] = ECMD_STATE_MAGIC;
+    cmd[1] = periodic_timers_next(0);   /* timer to print */
+    cmd[2] = 0;                         /* line of the timer */
+  }
+
+  uint8_t i = cmd[1];
+  if (i >= periodic_stats_max)
+    return ECMD_FINAL_OK;
+
+  periodic_stats_t *stats = &periodic_stats[i];
+  PGM_P name = periodic_stats_name(i);
+
+  if (cmd[2] == 0)
+  {
+    cmd[2] = 1;
+    if (name)
+      return ECMD_AGAIN(snprintf_P(output, len, PSTR("%S runs %u missed %u"),
+                                   name, stats->runs, stats->missed));
+    return ECMD_AGAIN(snprintf_P(output, len,
+                                 PSTR("dynamic %u runs %u missed %u"),
+                                 i - periodic_stats_names_max, stats->runs,
+                                 stats->missed));
+  }
+
+  cmd[1] = periodic_timers_next(i + 1);
+  cmd[2] = 0;
+
+  int16_t n = snprintf_P(output, len, PSTR(" late %u/%u/%u/%u us %u/%u"),
+                         stats->late[0], stats->late[1], stats->late[2],
+                         stats->late[3],
+                         stats->runs ? (uint16_t) (stats->run_sum /
+                                                   stats->runs) : 0,
+                         stats->run_max);
+
+  return (uint8_t) cmd[1] < periodic_stats_max ? ECMD_AGAIN(n) : ECMD_FINAL(n);
+}
+#endif /* PERIODIC_STATS_SUPPORT */
+
 /*
  -- Ethersex META --
  ecmd_ifdef(PERIODIC_ADJUST_SUPPORT)
@@ -154,4 +225,8 @@ parse_cmd_periodic_reset(char *cmd, char *output, uint16_t len)
   ecmd_feature(periodic_stats, "periodic stats",, Print debug statistics for periodic module.)
   ecmd_feature(periodic_reset, "periodic reset",, Reset debug statistics for periodic module.)
  ecmd_endif()
+ ecmd_ifdef(PERIODIC_STATS_SUPPORT)
+  block(Miscellaneous)
+  ecmd_feature(periodic_timers, "periodic timers", [reset], Print or reset the run-time statistics of all timers.)
+ ecmd_endif()
  */
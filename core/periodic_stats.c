@@ -0,0 +1,117 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (either version 2 or
+ * version 3) as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#include <string.h>
+
+#include <avr/pgmspace.h>
+
+#include <util/atomic.h>
+
+#include "config.h"
+
+#include "core/periodic.h"
+#include "core/periodic_stats.h"
+
+uint32_t periodic_stats_tick_due;
+
+void
+periodic_stats_update(uint8_t index, uint16_t late, uint16_t interval,
+                      periodic_timestamp_t * start)
+{
+  periodic_stats_t *stats = &periodic_stats[index];
+  uint32_t run = periodic_micros_elapsed(start);
+  uint8_t bucket = 0;
+
+  if (run > UINT16_MAX)
+    run = UINT16_MAX;
+
+  /* halve the counts instead of overflowing, the average stays right */
+  if (stats->runs == UINT16_MAX)
+  {
+    stats->runs /= 2;
+    stats->run_sum /= 2;
+  }
+
+  stats->runs++;
+  stats->run_sum += run;
+  if (run > stats->run_max)
+    stats->run_max = run;
+
+  for (uint16_t limit = PERIODIC_STATS_TICK;
+       bucket < PERIODIC_STATS_BUCKETS - 1 && late >= limit; limit *= 2)
+    bucket++;
+  if (stats->late[bucket] < UINT16_MAX)
+    stats->late[bucket]++;
+
+  /* at least one run has been skipped, timers faster than the tick
+   * are never run more often than once per tick */
+  if (late >= interval && late >= PERIODIC_STATS_TICK
+      && stats->missed < UINT16_MAX)
+    stats->missed++;
+}
+
+void
+periodic_stats_clear(uint8_t index)
+{
+  memset(&periodic_stats[index], 0, sizeof(periodic_stats_t));
+}
+
+void
+periodic_stats_reset(void)
+{
+  for (uint8_t i = 0; i < periodic_stats_max; i++)
+    periodic_stats_clear(i);
+}
+
+PGM_P
+periodic_stats_name(uint8_t index)
+{
+  if (index >= periodic_stats_names_max)
+    return NULL;
+
+  PGM_P name = periodic_stats_names;
+  while (index--)
+    name += strlen_P(name) + 1;
+
+  return name;
+}
+
+void
+periodic_stats_tick(void)
+{
+  /* millitick the previous tick was raised at */
+  static uint32_t last;
+  uint32_t now;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    now = periodic_mticks_count;
+  }
+
+  /* The ISR raises a tick every PERIODIC_STATS_TICK milliticks.  This
+   * one was due a tick after the previous one, ticks missed in between
+   * are lost and make the timers late. */
+  periodic_stats_tick_due = last ? last + PERIODIC_STATS_TICK
+    : now - now % PERIODIC_STATS_TICK;
+  last = now - now % PERIODIC_STATS_TICK;
+}
+
+/*
+ -- Ethersex META --
+ header(core/periodic_stats.h)
+ */
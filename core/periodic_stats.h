@@ -0,0 +1,95 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License (either version 2 or
+ * version 3) as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * For more information on the GPL, please go to:
+ * http://www.gnu.org/copyleft/gpl.html
+ */
+
+#ifndef _PERIODIC_STATS_H
+#define _PERIODIC_STATS_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+#ifdef PERIODIC_STATS_SUPPORT
+
+#include <avr/pgmspace.h>
+
+#include "core/periodic.h"
+
+/* Milliticks per timer() tick, i.e. per run of the main loop's timers. */
+#define PERIODIC_STATS_TICK     (CONF_MTICKS_PER_SEC / HZ)
+
+/* Lateness histogram: less than 1, 2, 4 and 4 or more ticks late. */
+#define PERIODIC_STATS_BUCKETS  4
+
+typedef struct
+{
+  uint16_t runs;
+  uint16_t missed;              /* runs late by one interval or more */
+  uint16_t late[PERIODIC_STATS_BUCKETS];
+  uint16_t run_max;             /* run-time in microseconds */
+  uint32_t run_sum;
+  uint16_t pending;             /* milliticks late at dispatch, scheduler */
+} periodic_stats_t;
+
+/* One entry per timer, generated by the meta scripts.  With the
+ * scheduler the static timers come first, dynamic timers follow. */
+extern periodic_stats_t periodic_stats[];
+extern const uint8_t periodic_stats_max;
+
+/* Function names of the static timers, each one terminated by \0. */
+extern const char periodic_stats_names[] PROGMEM;
+extern const uint8_t periodic_stats_names_max;
+
+/* Millitick the current timer() tick was due, without scheduler. */
+extern uint32_t periodic_stats_tick_due;
+
+/* Account one run of a timer that was due late milliticks ago. */
+void periodic_stats_update(uint8_t index, uint16_t late, uint16_t interval,
+                           periodic_timestamp_t * start);
+
+/* Forget everything about one timer, e.g. a re-used dynamic timer. */
+void periodic_stats_clear(uint8_t index);
+void periodic_stats_reset(void);
+
+/* Name of a static timer in program space, NULL for dynamic timers. */
+PGM_P periodic_stats_name(uint8_t index);
+
+/* Measure the lateness of the timer() tick, without scheduler. */
+void periodic_stats_tick(void);
+
+#define PERIODIC_STATS_TICK_START()     periodic_stats_tick()
+
+/* Run a timer() function of interval ticks, without scheduler. */
+#define PERIODIC_STATS_RUN(index, interval, call)                       \
+  do {                                                                  \
+    periodic_timestamp_t _start;                                        \
+    periodic_milliticks(&_start);                                       \
+    call;                                                               \
+    periodic_stats_update(index,                                        \
+                          (uint16_t) (_start.ticks -                    \
+                                      periodic_stats_tick_due),         \
+                          (interval) * PERIODIC_STATS_TICK, &_start);   \
+  } while (0)
+
+#else /* not PERIODIC_STATS_SUPPORT */
+
+#define PERIODIC_STATS_TICK_START()
+#define PERIODIC_STATS_RUN(index, interval, call)       call
+
+#endif /* PERIODIC_STATS_SUPPORT */
+
+#endif /* _PERIODIC_STATS_H */
@@ -25,6 +25,8 @@
 
 #include "dynamic.h"
 
+#include "core/periodic_stats.h"
+
 #include <util/atomic.h>
 
 /**
@@ -32,6 +34,9 @@
  */
 static int8_t add_timer(timer_t func, uint16_t delay, uint16_t interval, uint8_t flags);
 
+/* Position of a dynamic timer in the timer queue */
+#define QUEUE_INDEX(which)      (scheduler_static_timer_max + (uint8_t)(which))
+
 
 /**
  * Add a dynamic timer.
@@ -42,13 +47,20 @@ add_timer(timer_t func, uint16_t delay, uint16_t interval, uint8_t flags)
   for(uint8_t index = 0; index < scheduler_dynamic_timer_max; index++)
   {
     /* find free entry */
-    if (scheduler_dynamic_timers[index].state == TIMER_DELETED)
+    if (scheduler_dynamic_timers[index].control.state == TIMER_DELETED)
     {
       /* and add timer */
       scheduler_dynamic_timers[index].timer = func;
-      scheduler_dynamic_timers[index].delay = delay;
+      scheduler_dynamic_timers[index].control.delay = delay;
       scheduler_dynamic_timers[index].interval = interval;
-      scheduler_dynamic_timers[index].state = flags;
+      scheduler_dynamic_timers[index].control.state = flags;
+
+      if (TIMER_QUEUED(flags))
+        scheduler_queue_insert(QUEUE_INDEX(index), delay);
+
+#ifdef PERIODIC_STATS_SUPPORT
+      periodic_stats_clear(QUEUE_INDEX(index));
+#endif
 
       return (int8_t)index;
     }
@@ -107,8 +119,11 @@ scheduler_delete_timer(int8_t which)
 {
   if ((which >= 0) && (which < scheduler_dynamic_timer_max))
   {
-    scheduler_dynamic_timers[which].delay = SCHEDULER_INTERVAL_MAX;
-    scheduler_dynamic_timers[which].state = TIMER_DELETED;
+    if (TIMER_QUEUED(scheduler_dynamic_timers[which].control.state))
+      scheduler_queue_remove(QUEUE_INDEX(which));
+
+    scheduler_dynamic_timers[which].control.delay = SCHEDULER_INTERVAL_MAX;
+    scheduler_dynamic_timers[which].control.state = TIMER_DELETED;
 
     return SCHEDULER_OK;
   }
@@ -133,8 +148,12 @@ scheduler_suspend_timer(int8_t which)
 {
   if ((which >= 0) && (which < scheduler_dynamic_timer_max))
   {
-    scheduler_dynamic_timers[which].state &= (uint8_t)~TIMER_RUNNABLE;
-    scheduler_dynamic_timers[which].state |= TIMER_SUSPENDED;
+    // keeps the delay left for scheduler_resume_timer()
+    if (TIMER_QUEUED(scheduler_dynamic_timers[which].control.state))
+      scheduler_queue_remove(QUEUE_INDEX(which));
+
+    scheduler_dynamic_timers[which].control.state &= (uint8_t)~TIMER_RUNNABLE;
+    scheduler_dynamic_timers[which].control.state |= TIMER_SUSPENDED;
 
     return SCHEDULER_OK;
   }
@@ -158,8 +177,16 @@ scheduler_resume_timer(int8_t which)
 {
   if ((which >= 0) && (which < scheduler_dynamic_timer_max))
   {
-    scheduler_dynamic_timers[which].state &= (uint8_t)~TIMER_SUSPENDED;
-    scheduler_dynamic_timers[which].state |= TIMER_RUNNABLE;
+    if (TIMER_QUEUED(scheduler_dynamic_timers[which].control.state))
+      return SCHEDULER_OK;
+
+    scheduler_dynamic_timers[which].control.state &= (uint8_t)~TIMER_SUSPENDED;
+    scheduler_dynamic_timers[which].control.state |= TIMER_RUNNABLE;
+
+    // a running timer is queued by the scheduler loop when it returns
+    if (TIMER_QUEUED(scheduler_dynamic_timers[which].control.state))
+      scheduler_queue_insert(QUEUE_INDEX(which),
+                             scheduler_dynamic_timers[which].control.delay);
 
     return SCHEDULER_OK;
   }
@@ -183,12 +210,20 @@ scheduler_reset_timer(int8_t which)
 {
   if ((which >= 0) && (which < scheduler_dynamic_timer_max))
   {
+    if (TIMER_QUEUED(scheduler_dynamic_timers[which].control.state))
+      scheduler_queue_remove(QUEUE_INDEX(which));
+
     // reset delay
-    scheduler_dynamic_timers[which].delay = scheduler_dynamic_timers[which].interval;
+    scheduler_dynamic_timers[which].control.delay = scheduler_dynamic_timers[which].interval;
 
     // and (always) reset SUSPENDED flags, simply ignore if it's not set
-    scheduler_dynamic_timers[which].state &= (uint8_t)~TIMER_SUSPENDED;
-    scheduler_dynamic_timers[which].state |= TIMER_RUNNABLE;
+    scheduler_dynamic_timers[which].control.state &= (uint8_t)~TIMER_SUSPENDED;
+    scheduler_dynamic_timers[which].control.state |= TIMER_RUNNABLE;
+
+    // a running timer is queued by the scheduler loop when it returns
+    if (TIMER_QUEUED(scheduler_dynamic_timers[which].control.state))
+      scheduler_queue_insert(QUEUE_INDEX(which),
+                             scheduler_dynamic_timers[which].interval);
 
     return SCHEDULER_OK;
   }
@@ -26,6 +26,9 @@
 #include "scheduler.h"
 
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+#include "core/periodic_stats.h"
 
 #ifdef SCHEDULER_DYNAMIC_SUPPORT
 /*
@@ -40,78 +43,233 @@ const uint8_t scheduler_dynamic_timer_max = CONF_SCHEDULER_NUM_DYNAMIC_TIMERS;
 
 #endif /* SCHEDULER_DYNAMIC_SUPPORT */
 
+/*
+ * Milliticks elapsed since the last run of the scheduler loop.
+ */
+volatile uint16_t scheduler_elapsed;
+
+/*
+ * First timer in queue, i.e. the next one to expire.
+ */
+static uint8_t scheduler_queue_head = SCHEDULER_QUEUE_END;
+
 /**
- * The scheduler loop.
+ * Get the control block of a static or dynamic timer.
+ */
+static static_timer_cb_t *
+scheduler_control(uint8_t index)
+{
+#ifdef SCHEDULER_DYNAMIC_SUPPORT
+  if (index >= scheduler_static_timer_max)
+    return &scheduler_dynamic_timers[index - scheduler_static_timer_max].control;
+#endif /* SCHEDULER_DYNAMIC_SUPPORT */
+
+  return &scheduler_static_timers_control[index];
+}
+
+/**
+ * Insert a timer into the queue to expire delay milliticks from now.
  */
 void
-scheduler_dispatch_timer(void)
+scheduler_queue_insert(uint8_t index, uint16_t delay)
 {
-  uint8_t i;
+  uint8_t *link = &scheduler_queue_head;
+  static_timer_cb_t *control;
 
-  /* invoke all runnable static timers with a delay counter of zero */
-  for(i = 0; i < scheduler_static_timer_max; i++)
+  // walk past all timers expiring earlier or at the same time
+  while (*link != SCHEDULER_QUEUE_END)
   {
-    // check for a valid timer ready to run
-    if(((scheduler_static_timers_control[i].state & TIMER_RUNNABLE) == TIMER_RUNNABLE)
-        && (scheduler_static_timers_control[i].delay == 0))
+    control = scheduler_control(*link);
+    if (control->delay > delay)
     {
-      // call timer
-      timer_t timer_func = (timer_t)pgm_read_word(&(scheduler_static_timers[i].timer));
+      // the successor now counts from this timer
+      control->delay -= delay;
+      break;
+    }
+
+    delay -= control->delay;
+    link = &control->next;
+  }
+
+  control = scheduler_control(index);
+  control->delay = delay;
+  control->next = *link;
+  *link = index;
+}
 
-      // set flags
-      scheduler_static_timers_control[i].state &= (uint8_t)~TIMER_RUNNABLE;
-      scheduler_static_timers_control[i].state |= TIMER_RUNNING;
+/**
+ * Remove a timer from the queue, its delay is set to the milliticks
+ * it had left.
+ */
+void
+scheduler_queue_remove(uint8_t index)
+{
+  uint8_t *link = &scheduler_queue_head;
+  uint16_t delay = 0;
+  static_timer_cb_t *control;
 
-      (*timer_func)();
+  while (*link != SCHEDULER_QUEUE_END)
+  {
+    control = scheduler_control(*link);
+    delay += control->delay;
 
-      // reset delay
-      scheduler_static_timers_control[i].delay =
-          (uint16_t)pgm_read_word(&(scheduler_static_timers[i].interval));
+    if (*link == index)
+    {
+      *link = control->next;
+      if (*link != SCHEDULER_QUEUE_END)
+        scheduler_control(*link)->delay += control->delay;
 
-      // set back to runnable
-      scheduler_static_timers_control[i].state &= (uint8_t)~TIMER_RUNNING;
-      scheduler_static_timers_control[i].state |= TIMER_RUNNABLE;
+      control->delay = delay;
+      return;
     }
+
+    link = &control->next;
   }
+}
 
-#ifdef SCHEDULER_DYNAMIC_SUPPORT
-  for(i = 0; i < scheduler_dynamic_timer_max; i++)
+/**
+ * Milliticks until the first timer in queue expires, zero if it is due
+ * and SCHEDULER_INTERVAL_MAX if no timer is queued.
+ */
+uint16_t
+scheduler_next_due(void)
+{
+  uint16_t delay, elapsed;
+
+  if (scheduler_queue_head == SCHEDULER_QUEUE_END)
+    return SCHEDULER_INTERVAL_MAX;
+
+  delay = scheduler_control(scheduler_queue_head)->delay;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    elapsed = scheduler_elapsed;
+  }
+
+  return delay > elapsed ? delay - elapsed : 0;
+}
+
+/**
+ * Queue the static timers.
+ */
+void
+scheduler_init(void)
+{
+  for (uint8_t i = 0; i < scheduler_static_timer_max; i++)
+  {
+    if (TIMER_QUEUED(scheduler_static_timers_control[i].state))
+      scheduler_queue_insert(i, scheduler_static_timers_control[i].delay);
+  }
+}
+
+/**
+ * The scheduler loop.
+ */
+void
+scheduler_dispatch_timer(void)
+{
+  uint16_t elapsed;
+  uint8_t i;
+  static_timer_cb_t *control;
+  timer_t timer_func;
+  uint16_t interval;
+#ifdef PERIODIC_STATS_SUPPORT
+  periodic_timestamp_t dispatch, start;
+  uint16_t late;
+
+  periodic_milliticks(&dispatch);
+#endif
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
   {
-    // check for a valid timer ready to run
-    if(((scheduler_dynamic_timers[i].state & TIMER_RUNNABLE) == TIMER_RUNNABLE)
-        && (scheduler_dynamic_timers[i].delay == 0))
+    elapsed = scheduler_elapsed;
+    scheduler_elapsed = 0;
+  }
+
+  /* count down the queue, this touches expired timers and the next one only */
+  for (i = scheduler_queue_head; i != SCHEDULER_QUEUE_END && elapsed > 0;
+       i = control->next)
+  {
+    control = scheduler_control(i);
+    if (control->delay > elapsed)
     {
-      // call timer
-      scheduler_dynamic_timers[i].state &= (uint8_t)~TIMER_RUNNABLE;
-      scheduler_dynamic_timers[i].state |= TIMER_RUNNING;
-
-      (*scheduler_dynamic_timers[i].timer)();
-
-      if ((scheduler_dynamic_timers[i].state & TIMER_ONESHOT) == TIMER_ONESHOT)
-      {
-        // auto-delete one-shot timer
-        scheduler_dynamic_timers[i].delay = SCHEDULER_INTERVAL_MAX;
-        scheduler_dynamic_timers[i].state = TIMER_DELETED;
-
-      }
-      else if ((scheduler_dynamic_timers[i].state != TIMER_DELETED) &&
-          ((scheduler_dynamic_timers[i].state & TIMER_SUSPENDED) != TIMER_SUSPENDED))
-      {
-        // common dynamic timer - reset/restart values
-        scheduler_dynamic_timers[i].delay = scheduler_static_timers[i].interval;
-
-        // set back to runnable
-        scheduler_dynamic_timers[i].state &= (uint8_t)~TIMER_RUNNING;
-        scheduler_dynamic_timers[i].state |= TIMER_RUNNABLE;
-      }
-      else
-      {
-        // always reset RUNNING state
-        scheduler_dynamic_timers[i].state &= (uint8_t)~TIMER_RUNNING;
-      }
+      control->delay -= elapsed;
+      break;
     }
+
+    elapsed -= control->delay;
+    control->delay = 0;
+
+#ifdef PERIODIC_STATS_SUPPORT
+    // expired the remaining elapsed ticks ago
+    periodic_stats[i].pending = elapsed;
+#endif
   }
+
+  /* invoke all timers with a delay counter of zero */
+  while (scheduler_queue_head != SCHEDULER_QUEUE_END
+         && scheduler_control(scheduler_queue_head)->delay == 0)
+  {
+    i = scheduler_queue_head;
+    control = scheduler_control(i);
+    scheduler_queue_head = control->next;
+
+#ifdef SCHEDULER_DYNAMIC_SUPPORT
+    if (i >= scheduler_static_timer_max)
+    {
+      timer_func = scheduler_dynamic_timers[i - scheduler_static_timer_max].timer;
+      interval = scheduler_dynamic_timers[i - scheduler_static_timer_max].interval;
+    }
+    else
 #endif /* SCHEDULER_DYNAMIC_SUPPORT */
+    {
+      timer_func = (timer_t)pgm_read_word(&(scheduler_static_timers[i].timer));
+      interval = (uint16_t)pgm_read_word(&(scheduler_static_timers[i].interval));
+    }
+
+    // set flags
+    control->state &= (uint8_t)~TIMER_RUNNABLE;
+    control->state |= TIMER_RUNNING;
+
+#ifdef PERIODIC_STATS_SUPPORT
+    periodic_milliticks(&start);
+    late = periodic_stats[i].pending + (uint16_t)(start.ticks - dispatch.ticks);
+    periodic_stats[i].pending = 0;
+#endif
+
+    (*timer_func)();
+
+#ifdef PERIODIC_STATS_SUPPORT
+    periodic_stats_update(i, late, interval, &start);
+#endif
+
+    if ((control->state & TIMER_RUNNING) != TIMER_RUNNING)
+    {
+      // deleted and maybe re-added by the timer function
+      continue;
+    }
+
+    // always reset RUNNING state
+    control->state &= (uint8_t)~TIMER_RUNNING;
+
+    if ((control->state & TIMER_ONESHOT) == TIMER_ONESHOT)
+    {
+      // auto-delete one-shot timer
+      control->delay = SCHEDULER_INTERVAL_MAX;
+      control->state = TIMER_DELETED;
+    }
+    else if ((control->state & TIMER_SUSPENDED) != TIMER_SUSPENDED)
+    {
+      // set back to runnable and restart, a zero interval runs again
+      // one millitick later, not in this loop
+      control->state |= TIMER_RUNNABLE;
+      scheduler_queue_insert(i, interval ? interval : 1);
+    }
+    else
+    {
+      // suspended by the timer function, resumes with a delay of zero
+      control->delay = 0;
+    }
+  }
 
   return;
 }
@@ -120,6 +278,7 @@ scheduler_dispatch_timer(void)
 /*
   -- Ethersex META --
   header(core/scheduler/scheduler.h)
+  initearly(scheduler_init)
   periodic_milliticks_header(core/scheduler/scheduler.h)
   periodic_milliticks_isr(scheduler_tick())
 */
@@ -57,6 +57,11 @@
 /* reserved 0x40 */
 /* reserved 0x80 */
 
+/**
+ * End marker of the timer queue
+ */
+#define SCHEDULER_QUEUE_END     0xFF
+
 /**
  * typedef "timer_t as pointer to function (void) returning void" (from cdecl.org :-)
  */
@@ -72,18 +77,18 @@ typedef struct {
 } static_timer_func_t;
 
 typedef struct {
-  uint16_t      delay;
+  uint16_t      delay;          /* ticks after the previous timer in queue */
   uint8_t       state;
+  uint8_t       next;           /* next timer in queue */
 } static_timer_cb_t;
 
 /**
  * dynamic timer control block structure
  */
 typedef struct {
+  static_timer_cb_t control;
   timer_t       timer;
-  uint16_t      delay;
   uint16_t      interval;
-  uint8_t       state;
 } dynamic_timer_cb_t;
 
 /*
@@ -114,6 +119,43 @@ extern const uint8_t scheduler_dynamic_timer_max;
 
 #endif /* SCHEDULER_DYNAMIC_SUPPORT */
 
+/*
+ * Milliticks elapsed since the last run of the scheduler loop.
+ */
+extern volatile uint16_t scheduler_elapsed;
+
+/**
+ * Runnable timers are kept in a queue ordered by expiry, each one's
+ * delay counting from the expiry of its predecessor.  Static timers
+ * are numbered first, dynamic timers follow.
+ *
+ * A timer is queued while it is runnable and not running.
+ */
+#define TIMER_QUEUED(state) \
+  (((state) & (TIMER_RUNNABLE | TIMER_RUNNING)) == TIMER_RUNNABLE)
+
+/**
+ * Insert a timer into the queue to expire delay milliticks from now.
+ */
+void scheduler_queue_insert(uint8_t index, uint16_t delay);
+
+/**
+ * Remove a timer from the queue, its delay is set to the milliticks
+ * it had left.
+ */
+void scheduler_queue_remove(uint8_t index);
+
+/**
+ * Milliticks until the first timer in queue expires, zero if it is due
+ * and SCHEDULER_INTERVAL_MAX if no timer is queued.
+ */
+uint16_t scheduler_next_due(void);
+
+/**
+ * Queue the static timers.
+ */
+void scheduler_init(void);
+
 /**
  * The scheduler loop.
  */
@@ -126,36 +168,16 @@ void scheduler_dispatch_timer(void);
  * Keep it SHORT and simple.
  *
  * We definitely want to inline all millitickers.
+ *
+ * Only count the millitick, the scheduler loop applies all ticks elapsed
+ * to the head of the timer queue.  The cost does not depend on the number
+ * of timers.
  */
 __attribute__((always_inline)) static inline void scheduler_tick(void)
 {
-  uint8_t i;
-
-  for(i = 0; i < scheduler_static_timer_max; i++)
-  {
-    /* check for runnable static timer with delay greater zero (to prevent underflow in
-     * case a timer could not be dispatched in time.
-     */
-    if((scheduler_static_timers_control[i].state & TIMER_RUNNABLE) && (scheduler_static_timers_control[i].delay > 0))
-    {
-      scheduler_static_timers_control[i].delay--;
-    }
-  }
-
-#ifdef SCHEDULER_DYNAMIC_SUPPORT
-  for(i = 0; i < scheduler_dynamic_timer_max; i++)
-  {
-    /* check for runnable dynamic timer with delay greater zero (to prevent underflow in
-     * case a timer could not be dispatched in time.
-     */
-    if((scheduler_dynamic_timers[i].state & TIMER_RUNNABLE) && (scheduler_dynamic_timers[i].delay > 0))
-    {
-      scheduler_dynamic_timers[i].delay--;
-    }
-  }
-#endif /* SCHEDULER_DYNAMIC_SUPPORT */
-
-  return;
+  /* saturate in case the scheduler loop is blocked for a long time */
+  if (scheduler_elapsed < UINT16_MAX)
+    scheduler_elapsed++;
 }
 
 #endif /* SCHEDULER_H_ */
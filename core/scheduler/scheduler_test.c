@@ -29,6 +29,13 @@
 
 #include <services/clock/clock.h>
 
+#ifdef SCHEDULER_DYNAMIC_SUPPORT
+#include <util/atomic.h>
+
+#include "core/periodic.h"
+#include "dynamic.h"
+#endif
+
 void scheduler_test_periodic_t50(void)
 {
   SCHEDULERDEBUG("test timer(50, ...) - %lu\n", clock_get_time());
@@ -38,9 +45,86 @@ void scheduler_test_periodic_mt1000(void)
 {
   SCHEDULERDEBUG("test millitimer(1000, ...) - %lu\n", clock_get_time());
 }
+
+#ifdef SCHEDULER_DYNAMIC_SUPPORT
+static void
+scheduler_test_nop(void)
+{
+}
+
+/* CPU cycles between two readings of the periodic timer/counter */
+static uint16_t
+scheduler_test_cycles(uint16_t start, uint16_t end)
+{
+  if (end < start)
+    end += PERIODIC_TOP + 1;
+
+  return (end - start) * PERIODIC_PRESCALER;
+}
+
+/**
+ * Benchmark the millitick in the periodic ISR and the insertion of a
+ * timer into the queue with a growing number of dynamic timers.
+ */
+void
+scheduler_test_benchmark(void)
+{
+  int8_t handles[CONF_SCHEDULER_NUM_DYNAMIC_TIMERS];
+  uint16_t start, end, overhead, tick, insert;
+  uint8_t n;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    start = PERIODIC_COUNTER_CURRENT;
+    end = PERIODIC_COUNTER_CURRENT;
+  }
+  overhead = scheduler_test_cycles(start, end);
+
+  for (n = 0; ; n++)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      start = PERIODIC_COUNTER_CURRENT;
+      scheduler_tick();
+      end = PERIODIC_COUNTER_CURRENT;
+
+      // take the tick back, this one did not really happen
+      scheduler_elapsed--;
+    }
+    tick = scheduler_test_cycles(start, end) - overhead;
+
+    if (n == scheduler_dynamic_timer_max)
+    {
+      SCHEDULERDEBUG("benchmark %u+%u timers: tick %u cycles\n",
+                     scheduler_static_timer_max, n, tick);
+      break;
+    }
+
+    // the longest interval walks the whole queue
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      start = PERIODIC_COUNTER_CURRENT;
+      handles[n] = scheduler_add_timer(scheduler_test_nop,
+                                       SCHEDULER_INTERVAL_MAX, false);
+      end = PERIODIC_COUNTER_CURRENT;
+    }
+    insert = scheduler_test_cycles(start, end) - overhead;
+
+    SCHEDULERDEBUG("benchmark %u+%u timers: tick %u cycles, insert %u cycles\n",
+                   scheduler_static_timer_max, n, tick, insert);
+
+    if (handles[n] < 0)
+      break;
+  }
+
+  while (n--)
+    scheduler_delete_timer(handles[n]);
+}
+#endif /* SCHEDULER_DYNAMIC_SUPPORT */
 /*
   -- Ethersex META --
   header(core/scheduler/scheduler_test.h)
   ifdef(`conf_DEBUG_SCHEDULER',`timer(50, scheduler_test_periodic_t50)')
   ifdef(`conf_DEBUG_SCHEDULER',`millitimer(1000, scheduler_test_periodic_mt1000)')
+  ifdef(`conf_DEBUG_SCHEDULER',`ifdef(`conf_SCHEDULER_DYNAMIC',`startup(scheduler_test_benchmark)')')
 */
@@ -29,3 +29,6 @@ scheduler_test_periodic_t50(void);
 
 void
 scheduler_test_periodic_mt1000(void);
+
+void
+scheduler_test_benchmark(void);
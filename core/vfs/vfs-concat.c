@@ -36,7 +36,9 @@ usage(int exitval)
 {
   fprintf(exitval ? stderr : stdout,
           "Usage: vfs-concat IMAGE BLOCKSZ FILE\n"
-          "Concatenate FILE to existing ethersex IMAGE.\n\n");
+          "       vfs-concat --index IMAGE BLOCKSZ START\n"
+          "Concatenate FILE to existing ethersex IMAGE, or put a sorted\n"
+          "name index in front of the files embedded after offset START.\n\n");
   exit(exitval);
 }
 
@@ -58,6 +60,23 @@ crc_update(uint8_t crc, uint8_t data)
 }
 
 
+static uint16_t
+crc16_update(uint16_t crc, uint8_t data)
+{
+  uint8_t i;
+  crc ^= data;
+  for (i = 0; i < 8; i++)
+  {
+    if (crc & 1)
+      crc = (crc >> 1) ^ 0xA001;
+    else
+      crc = crc >> 1;
+  }
+
+  return crc;
+}
+
+
 static uint8_t
 crc_calc(uint8_t * data, int len)
 {
@@ -71,11 +90,139 @@ crc_calc(uint8_t * data, int len)
 }
 
 
+struct index_file
+{
+  struct vfs_inline_index_entry_t entry;
+  int node;                     /* Offset of the node in the old image. */
+};
+
+static int
+index_cmp(const void *a, const void *b)
+{
+  return strncmp(((const struct index_file *) a)->entry.fn,
+                 ((const struct index_file *) b)->entry.fn,
+                 VFS_INLINE_FNLEN);
+}
+
+static int
+build_index(char *image, int pagesz, int start)
+{
+  static uint8_t buf_image[MAX_IMAGE_SIZE];
+  static struct index_file files[MAX_IMAGE_SIZE / 64];
+  struct vfs_inline_index_t index = {.count = 0 };
+  union vfs_inline_node_t node;
+  int image_len, offset, i, j;
+  FILE *f;
+
+  if ((f = fopen(image, "rb")) == NULL)
+  {
+    fprintf(stderr, "vfs-concat: Unable to read %s.\n", image);
+    return 1;
+  }
+
+  image_len = fread(buf_image, 1, MAX_IMAGE_SIZE, f);
+  fclose(f);
+
+  if (start <= 0 || start > image_len)
+  {
+    fprintf(stderr, "vfs-concat: Invalid start offset: %d.\n", start);
+    return 1;
+  }
+
+  /* Collect the embedded files, a later one replaces an earlier one
+     of the same name, just like the backward scan does. */
+  for (offset = (start + pagesz - 1) / pagesz * pagesz;
+       offset + 1 + (int) sizeof(node) <= image_len; offset += pagesz)
+  {
+    if (buf_image[offset] != VFS_INLINE_MAGIC)
+      continue;
+
+    memcpy(&node, buf_image + offset + 1, sizeof(node));
+    if (node.s.crc != crc_calc(node.raw, sizeof(node) - 1)
+        || offset + 1 + (int) sizeof(node) + node.s.len > image_len)
+      continue;
+
+    for (i = 0; i < index.count; i++)
+      if (strncmp(files[i].entry.fn, node.s.fn, VFS_INLINE_FNLEN) == 0)
+        break;
+
+    if (i == index.count)
+      index.count++;
+
+    memcpy(files[i].entry.fn, node.s.fn, VFS_INLINE_FNLEN);
+    files[i].entry.len = node.s.len;
+    files[i].node = offset;
+  }
+
+  qsort(files, index.count, sizeof(files[0]), index_cmp);
+
+  /* The index takes the first page(s) after the firmware, the files
+     follow page aligned, so that the backward scan still finds them. */
+  offset = (start + pagesz - 1) / pagesz * pagesz;
+  offset += (1 + sizeof(index) + index.count * sizeof(files[0].entry)
+             + pagesz - 1) / pagesz * pagesz;
+
+  for (i = 0; i < index.count; i++)
+  {
+    files[i].entry.offset = offset + 1 + sizeof(node);
+    offset += (1 + sizeof(node) + files[i].entry.len + pagesz - 1)
+      / pagesz * pagesz;
+  }
+
+  if (offset > MAX_IMAGE_SIZE)
+  {
+    fprintf(stderr, "vfs-concat: Image with index too large.\n");
+    return 1;
+  }
+
+  index.crc = crc_update(crc_update(0, index.count & 0xFF), index.count >> 8);
+  for (i = 0; i < index.count; i++)
+    for (j = 0; j < (int) sizeof(files[i].entry); j++)
+      index.crc = crc_update(index.crc, ((uint8_t *) &files[i].entry)[j]);
+
+  fprintf(stderr, "vfs-concat: Index of %d files.\n", index.count);
+
+  fwrite(buf_image, 1, start, stdout);
+  offset = start;
+
+  while (offset % pagesz)
+  {
+    putchar(0xFF);
+    offset++;
+  }
+
+  putchar(VFS_INLINE_INDEX_MAGIC);
+  fwrite(&index, sizeof(index), 1, stdout);
+  offset += 1 + sizeof(index);
+
+  for (i = 0; i < index.count; i++)
+  {
+    fwrite(&files[i].entry, sizeof(files[i].entry), 1, stdout);
+    offset += sizeof(files[i].entry);
+  }
+
+  for (i = 0; i < index.count; i++)
+  {
+    while (offset % pagesz)
+    {
+      putchar(0xFF);
+      offset++;
+    }
+
+    j = 1 + sizeof(node) + files[i].entry.len;
+    fwrite(buf_image + files[i].node, 1, j, stdout);
+    offset += j;
+  }
+
+  return 0;
+}
+
+
 int
 main(int argc, char **argv)
 {
   uint8_t buf_image[MAX_IMAGE_SIZE], buf_file[MAX_IMAGE_SIZE];
-  int image_len, file_len, pagesz;
+  int image_len, file_len, pagesz, i;
   FILE *f;
   union vfs_inline_node_t node = {.s = {.fn = "",.len = 0} };
   char *ptr;
@@ -83,7 +230,12 @@ main(int argc, char **argv)
 
   if (argc == 2 && strcmp(argv[1], "--help") == 0)
     usage(0);
-  if (argc != 4)
+  if (argc == 5 && strcmp(argv[1], "--index") == 0)
+  {
+    argc--;
+    argv++;
+  }
+  else if (argc != 4)
     usage(1);
 
   pagesz = atoi(argv[2]);
@@ -93,6 +245,9 @@ main(int argc, char **argv)
     return 1;
   }
 
+  if (strcmp(argv[0], "--index") == 0)
+    return build_index(argv[1], pagesz, atoi(argv[3]));
+
   if ((f = fopen(argv[1], "rb")) == NULL)
   {
     fprintf(stderr, "vfs-concat: Unable to read %s.\n", argv[1]);
@@ -144,6 +299,9 @@ main(int argc, char **argv)
 
   strncpy(node.s.fn, argv[3], VFS_INLINE_FNLEN);
   node.s.len = file_len;
+  node.s.sum = 0xFFFF;
+  for (i = 0; i < file_len; i++)
+    node.s.sum = crc16_update(node.s.sum, buf_file[i]);
   node.s.crc = crc_calc(node.raw, sizeof(node) - 1);
 
   fwrite(&node, sizeof(node), 1, stdout);
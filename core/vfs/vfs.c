@@ -21,6 +21,7 @@
  */
 
 #include <avr/pgmspace.h>
+#include <string.h>
 #include "core/debug.h"
 #include "core/vfs/vfs.h"
 #ifndef VFS_TEENSY
@@ -56,18 +57,122 @@ const struct vfs_func_t vfs_funcs[] PROGMEM = {
 };
 
 
+#ifdef VFS_MOUNT_SUPPORT
+/* Check whether NAME starts with a mount point, i.e. "/" followed by the
+   module name and another "/".  Fills FUNCS and points NAME to the rest of
+   the file name, or returns VFS_LAST if there is no mount point. */
+static uint8_t
+vfs_mount_lookup(const char **name, struct vfs_func_t *funcs)
+{
+  if (**name != '/')
+    return VFS_LAST;
+
+  for (uint8_t i = 0; i < VFS_LAST; i++)
+  {
+    memcpy_P(funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
+    uint8_t len = strlen(funcs->mod_name);
+    if (strncmp(*name + 1, funcs->mod_name, len) == 0
+        && (*name)[len + 1] == '/')
+    {
+      *name += len + 2;
+      return i;
+    }
+  }
+
+  return VFS_LAST;
+}
+#endif /* VFS_MOUNT_SUPPORT */
+
+#ifdef VFS_LOOKUP_CACHE_SUPPORT
+#define VFS_LOOKUP_CACHE_NAMELEN 16
+
+/* Recently opened names without mount point and the module that had the
+   file.  Misses are not remembered, files may appear behind our back. */
+static struct
+{
+  char name[VFS_LOOKUP_CACHE_NAMELEN];
+  uint8_t mod;
+} vfs_lookup_cache[VFS_LOOKUP_CACHE];
+static uint8_t vfs_lookup_cache_next;
+
+static uint8_t
+vfs_lookup_cache_find(const char *name)
+{
+  for (uint8_t i = 0; i < VFS_LOOKUP_CACHE; i++)
+    if (vfs_lookup_cache[i].name[0]
+        && strncmp(vfs_lookup_cache[i].name, name,
+                   VFS_LOOKUP_CACHE_NAMELEN) == 0)
+      return i;
+
+  return VFS_LOOKUP_CACHE;
+}
+
+static void
+vfs_lookup_cache_store(const char *name, uint8_t mod)
+{
+  if (strlen(name) >= VFS_LOOKUP_CACHE_NAMELEN)
+    return;                     /* Too long to be remembered. */
+
+  uint8_t i = vfs_lookup_cache_find(name);
+  if (i == VFS_LOOKUP_CACHE)
+  {
+    i = vfs_lookup_cache_next;
+    vfs_lookup_cache_next = (i + 1) % VFS_LOOKUP_CACHE;
+    strcpy(vfs_lookup_cache[i].name, name);
+  }
+  vfs_lookup_cache[i].mod = mod;
+}
+
+/* Files have been created or removed, the order of the modules decides
+   again. */
+static void
+vfs_lookup_cache_flush(void)
+{
+  for (uint8_t i = 0; i < VFS_LOOKUP_CACHE; i++)
+    vfs_lookup_cache[i].name[0] = 0;
+}
+#else
+#define vfs_lookup_cache_store(name, mod)
+#define vfs_lookup_cache_flush()
+#endif /* VFS_LOOKUP_CACHE_SUPPORT */
+
+
 struct vfs_file_handle_t *
 vfs_open(const char *filename)
 {
   struct vfs_file_handle_t *fh = NULL;
-  for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i++)
+  struct vfs_func_t funcs;
+
+#ifdef VFS_MOUNT_SUPPORT
+  if (vfs_mount_lookup(&filename, &funcs) != VFS_LAST)
+    return funcs.open ? funcs.open(filename) : NULL;
+#endif
+
+#ifdef VFS_LOOKUP_CACHE_SUPPORT
+  uint8_t c = vfs_lookup_cache_find(filename);
+  if (c != VFS_LOOKUP_CACHE)
+  {
+    /* Try the module that had the file last time first. */
+    memcpy_P(&funcs, &vfs_funcs[vfs_lookup_cache[c].mod],
+             sizeof(struct vfs_func_t));
+    if ((fh = funcs.open(filename)))
+      return fh;
+
+    vfs_lookup_cache[c].name[0] = 0;    /* Gone from there. */
+  }
+#endif
+
+  uint8_t i;
+  for (i = 0; fh == NULL && i < VFS_LAST; i++)
   {
-    struct vfs_func_t funcs;
     memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
     if (funcs.open)
       fh = funcs.open(filename);
   }
 
+  /* The loop has run once more after the successful open. */
+  if (fh)
+    vfs_lookup_cache_store(filename, i - 1);
   return fh;
 }
 
@@ -75,9 +180,17 @@ struct vfs_file_handle_t *
 vfs_create(const char *name)
 {
   struct vfs_file_handle_t *fh = NULL;
+  struct vfs_func_t funcs;
+
+  vfs_lookup_cache_flush();
+
+#ifdef VFS_MOUNT_SUPPORT
+  if (vfs_mount_lookup(&name, &funcs) != VFS_LAST)
+    return funcs.create ? funcs.create(name) : NULL;
+#endif
+
   for (uint8_t i = 0; fh == NULL && i < VFS_LAST; i++)
   {
-    struct vfs_func_t funcs;
     memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
     if (funcs.create)
       fh = funcs.create(name);
@@ -106,6 +219,31 @@ vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t * handle,
   return 0;
 }
 
+vfs_size_t
+vfs_pread(struct vfs_file_handle_t * handle, void *buf, vfs_size_t length,
+          vfs_size_t offset)
+{
+  struct vfs_func_t funcs;
+  memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
+
+  if (funcs.pread)
+    return funcs.pread(handle, buf, length, offset);
+
+  if (funcs.fseek && funcs.read && funcs.fseek(handle, offset, SEEK_SET) == 0)
+    return funcs.read(handle, buf, length);
+
+  return 0;
+}
+
+uint32_t
+vfs_etag(struct vfs_file_handle_t * handle)
+{
+  struct vfs_func_t funcs;
+  memcpy_P(&funcs, &vfs_funcs[handle->fh_type], sizeof(struct vfs_func_t));
+
+  return funcs.etag ? funcs.etag(handle) : 0;
+}
+
 /* flag: 0=fseek, 1=truncate, 2=close */
 uint8_t
 vfs_fseek_truncate_close(uint8_t flag, struct vfs_file_handle_t * handle,
@@ -131,9 +269,17 @@ uint8_t
 vfs_unlink(const char *name)
 {
   uint8_t retval = 1;
+  struct vfs_func_t funcs;
+
+  vfs_lookup_cache_flush();
+
+#ifdef VFS_MOUNT_SUPPORT
+  if (vfs_mount_lookup(&name, &funcs) != VFS_LAST)
+    return funcs.unlink ? funcs.unlink(name) : retval;
+#endif
+
   for (uint8_t i = 0; retval != 0 && i < VFS_LAST; i++)
   {
-    struct vfs_func_t funcs;
     memcpy_P(&funcs, &vfs_funcs[i], sizeof(struct vfs_func_t));
     if (funcs.unlink)
       retval = funcs.unlink(name);
@@ -138,6 +138,16 @@ struct vfs_func_t
 
   /* Return the size of the file. */
     vfs_size_t(*size) (struct vfs_file_handle_t *);
+
+  /* Read LENGTH bytes starting at OFFSET straight from the backing store,
+   * without seeking first.  The file position is undefined afterwards.
+   * Returns the number of bytes actually read. */
+    vfs_size_t(*pread) (struct vfs_file_handle_t *, void *buf,
+                        vfs_size_t length, vfs_size_t offset);
+
+  /* Return a value that changes whenever the contents of the file
+   * change, 0 if that's unknown. */
+    uint32_t(*etag) (struct vfs_file_handle_t *);
 };
 
 extern const struct vfs_func_t vfs_funcs[];
@@ -163,6 +173,14 @@ uint8_t vfs_unlink(const char *filename);
 vfs_size_t vfs_read_write_size(uint8_t flag, struct vfs_file_handle_t *handle,
                                void *buf, vfs_size_t length);
 
+/* Read LENGTH bytes at OFFSET, falls back to fseek and read if the
+   module cannot read at an offset directly. */
+vfs_size_t vfs_pread(struct vfs_file_handle_t *handle, void *buf,
+                     vfs_size_t length, vfs_size_t offset);
+
+/* Entity tag for HTTP caching, 0 if the module doesn't have one. */
+uint32_t vfs_etag(struct vfs_file_handle_t *handle);
+
 #define VFS_FUNC(handle,call)	              \
   ((pgm_read_word(((void *)&(vfs_funcs[(handle)->fh_type].call))))
 
@@ -20,8 +20,11 @@
  */
 
 #include <avr/pgmspace.h>
+#include <util/crc16.h>
 
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "core/eeprom.h"
 #include "core/vfs/vfs.h"
@@ -33,9 +36,110 @@
 #endif
 
 
+static struct vfs_file_handle_t *
+vfs_inline_handle (vfs_size_t offset, uint16_t len)
+{
+  struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
+  if (fh == NULL)
+    return NULL;
+
+  fh->fh_type = VFS_INLINE;
+  fh->u.il.offset = offset;
+  fh->u.il.pos = 0;
+  fh->u.il.len = len;
+  return fh;
+}
+
+#ifdef VFS_INLINE_INDEX_SUPPORT
+/* End of the firmware image, the index follows in the next page. */
+extern char __data_load_end[];
+
+#define VFS_INLINE_INDEX_UNCHECKED	0
+#define VFS_INLINE_INDEX_VALID		1
+#define VFS_INLINE_INDEX_ABSENT		2
+
+static uint8_t vfs_inline_index_state;
+static uint16_t vfs_inline_index_count;
+static vfs_size_t vfs_inline_index_entries;
+
+static void
+vfs_inline_index_check (void)
+{
+#if FLASHEND > UINT16_MAX
+  vfs_size_t offset = pgm_get_far_address (__data_load_end);
+#else
+  vfs_size_t offset = (uint16_t) __data_load_end;
+#endif
+  offset = (offset + SPM_PAGESIZE - 1) & ~((vfs_size_t) SPM_PAGESIZE - 1);
+
+  vfs_inline_index_state = VFS_INLINE_INDEX_ABSENT;
+  if (__pgm_read_byte (offset) != VFS_INLINE_INDEX_MAGIC)
+    return;
+
+  struct vfs_inline_index_t index;
+  for (uint8_t i = 0; i < sizeof (index); i ++)
+    ((uint8_t *) &index)[i] = __pgm_read_byte (offset + i + 1);
+
+  /* The checksum covers the count and all entries, so the index is
+     checked only once. */
+  vfs_size_t entries = offset + sizeof (index) + 1;
+  vfs_size_t end = entries
+    + (vfs_size_t) index.count * sizeof (struct vfs_inline_index_entry_t);
+  if (end > FLASHEND)
+    return;
+
+  uint8_t crc = _crc_ibutton_update (0, index.count & 0xff);
+  crc = _crc_ibutton_update (crc, index.count >> 8);
+  for (offset = entries; offset < end; offset ++)
+    crc = _crc_ibutton_update (crc, __pgm_read_byte (offset));
+  if (crc != index.crc)
+    return;
+
+  vfs_inline_index_state = VFS_INLINE_INDEX_VALID;
+  vfs_inline_index_count = index.count;
+  vfs_inline_index_entries = entries;
+}
+
+static struct vfs_file_handle_t *
+vfs_inline_index_open (const char *filename)
+{
+  uint16_t lo = 0, hi = vfs_inline_index_count;
+
+  while (lo < hi)
+    {
+      uint16_t mid = (lo + hi) / 2;
+      vfs_size_t offset = vfs_inline_index_entries
+	+ (vfs_size_t) mid * sizeof (struct vfs_inline_index_entry_t);
+
+      struct vfs_inline_index_entry_t entry;
+      for (uint8_t i = 0; i < sizeof (entry); i ++)
+	((uint8_t *) &entry)[i] = __pgm_read_byte (offset + i);
+
+      int cmp = strncmp (entry.fn, filename, VFS_INLINE_FNLEN);
+      if (cmp == 0)
+	return vfs_inline_handle (entry.offset, entry.len);
+
+      if (cmp < 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return NULL;			/* File not found. */
+}
+#endif	/* VFS_INLINE_INDEX_SUPPORT */
+
 struct vfs_file_handle_t *
 vfs_inline_open (const char *filename)
 {
+#ifdef VFS_INLINE_INDEX_SUPPORT
+  if (vfs_inline_index_state == VFS_INLINE_INDEX_UNCHECKED)
+    vfs_inline_index_check ();
+  if (vfs_inline_index_state == VFS_INLINE_INDEX_VALID)
+    return vfs_inline_index_open (filename);
+#endif
+
+  /* No index, scan the pages for file headers. */
   vfs_size_t offset = FLASHEND - SPM_PAGESIZE + 1;
   for (; offset; offset -= SPM_PAGESIZE) {
     if (__pgm_read_byte (offset) != VFS_INLINE_MAGIC)
@@ -54,15 +158,8 @@ vfs_inline_open (const char *filename)
       continue;
 
     /* Found file, create a handle. */
-    struct vfs_file_handle_t *fh = malloc (sizeof (struct vfs_file_handle_t));
-    if (fh == NULL)
-      return NULL;
-
-    fh->fh_type = VFS_INLINE;
-    fh->u.il.offset = offset + sizeof (union vfs_inline_node_t) + 1;
-    fh->u.il.pos = 0;
-    fh->u.il.len = node.s.len;
-    return fh;
+    return vfs_inline_handle (offset + sizeof (union vfs_inline_node_t) + 1,
+			      node.s.len);
   }
 
   return NULL;			/* File not found. */
@@ -90,6 +187,34 @@ vfs_inline_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
   return len;
 }
 
+vfs_size_t
+vfs_inline_pread (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length,
+		  vfs_size_t offset)
+{
+  if (offset >= fh->u.il.len)
+    return 0;
+  if (length > fh->u.il.len - offset)
+    length = fh->u.il.len - offset;
+
+#if FLASHEND > UINT16_MAX
+  memcpy_PF (buf, fh->u.il.offset + offset, length);
+#else
+  memcpy_P (buf, (PGM_VOID_P) (uint16_t) (fh->u.il.offset + offset), length);
+#endif
+  return length;
+}
+
+uint32_t
+vfs_inline_etag (struct vfs_file_handle_t *fh)
+{
+  /* The node header is right in front of the data. */
+  vfs_size_t sum = fh->u.il.offset - sizeof (union vfs_inline_node_t)
+    + offsetof (union vfs_inline_node_t, s.sum);
+
+  return (uint32_t) __pgm_read_byte (sum + 1) << 24
+    | (uint32_t) __pgm_read_byte (sum) << 16 | fh->u.il.len;
+}
+
 #ifndef VFS_TEENSY
 uint8_t
 vfs_inline_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset,
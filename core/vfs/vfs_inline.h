@@ -31,12 +31,28 @@ union vfs_inline_node_t {
   struct __attribute__((__packed__)) {
     char fn[VFS_INLINE_FNLEN];
     uint16_t len;
+    uint16_t sum;		/* CRC-16 of the file data. */
     uint8_t crc;
   } s ;
 
   unsigned char raw[0];
 };
 
+/* Name index, placed by do-embed into the first page after the firmware:
+   VFS_INLINE_INDEX_MAGIC, the header and `count' entries sorted by name. */
+#define VFS_INLINE_INDEX_MAGIC 0x24
+
+struct __attribute__((__packed__)) vfs_inline_index_t {
+  uint16_t count;
+  uint8_t crc;			/* Over count and all entries. */
+};
+
+struct __attribute__((__packed__)) vfs_inline_index_entry_t {
+  char fn[VFS_INLINE_FNLEN];
+  uint16_t len;
+  uint32_t offset;		/* Offset of the data in program memory. */
+};
+
 typedef struct {
   vfs_size_t offset;		/* Offset in program memory. */
   uint16_t pos;			/* Position in file. */
@@ -51,6 +67,9 @@ vfs_size_t vfs_inline_read  (struct vfs_file_handle_t *, void *buf,
 vfs_size_t vfs_inline_size (struct vfs_file_handle_t *);
 uint8_t vfs_inline_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
 			  uint8_t whence);
+vfs_size_t vfs_inline_pread (struct vfs_file_handle_t *, void *buf,
+			     vfs_size_t length, vfs_size_t offset);
+uint32_t vfs_inline_etag (struct vfs_file_handle_t *);
 
 
 #define VFS_INLINE_FUNCS {		\
@@ -64,6 +83,8 @@ uint8_t vfs_inline_fseek (struct vfs_file_handle_t *, vfs_size_t offset,
     NULL, /* create */			\
     NULL, /* unlink */			\
     vfs_inline_size,			\
+    vfs_inline_pread,			\
+    vfs_inline_etag,			\
   }
 
 #endif	/* VFS_INLINE_H */
@@ -34,6 +34,8 @@
 #undef vfs_truncate
 #undef vfs_size
 #undef vfs_rewind
+#undef vfs_pread
+#undef vfs_etag
 
 #define vfs_open	vfs_inline_open
 #define vfs_read	vfs_inline_read
@@ -41,5 +43,7 @@
 #define vfs_fseek(fh,p,w)   (((w) == SEEK_SET) ? ((fh)->u.il.pos = (p)) : -1)
 #define vfs_size(fh)	((fh)->u.il.len)
 #define vfs_rewind(fh)  ((fh)->u.il.pos = 0)
+#define vfs_pread	vfs_inline_pread
+#define vfs_etag	vfs_inline_etag
 
 #endif  /* VFS_TEENSY_H */
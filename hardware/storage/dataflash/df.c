@@ -37,6 +37,10 @@
 #  define cs_high() PIN_SET(SPI_CS_DF)
 #endif
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+uint32_t df_flash_reads;
+#endif
+
 
 void df_init(df_chip_t chip)
 {
@@ -50,6 +54,10 @@ void df_buf_load(df_chip_t chip, df_buf_t buffer, df_page_t page)
 
     // df_wait(chip);
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+    df_flash_reads++;
+#endif
+
     cs_low();
 
     /* send opcode */
@@ -158,6 +166,10 @@ void df_flash_read(df_chip_t chip, df_page_t page_address, void* data, df_size_t
 
     // dataflash_wait_busy();
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+    df_flash_reads++;
+#endif
+
     cs_low();
 
     /* send opcode */
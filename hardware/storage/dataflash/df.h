@@ -77,4 +77,9 @@ void df_erase(df_chip_t, df_page_t);
 df_status_t df_status(df_chip_t);
 void df_wait(df_chip_t);
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+/* number of reads from main memory, for the `df stats' command */
+extern uint32_t df_flash_reads;
+#endif
+
 #endif /* _DATAFLASH_H */
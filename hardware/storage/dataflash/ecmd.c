@@ -28,6 +28,7 @@
 #include "config.h"
 #include "hardware/storage/dataflash/df.h"
 #include "hardware/storage/dataflash/fs.h"
+#include "core/vfs/vfs.h"
 
 #include "protocols/ecmd/ecmd-base.h"
 
@@ -42,6 +43,21 @@ parse_cmd_df_status (char *cmd, char *output, uint16_t len)
 }
 
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+int16_t
+parse_cmd_df_stats (char *cmd, char *output, uint16_t len)
+{
+  (void) cmd;
+
+  return ECMD_FINAL(snprintf_P(output, len,
+			       PSTR("seeks %lu, reads %lu, reads/seek %lu"),
+			       vfs_df_seeks, vfs_df_seek_reads,
+			       vfs_df_seeks ? vfs_df_seek_reads / vfs_df_seeks
+			       : 0));
+}
+#endif
+
+
 int16_t
 parse_cmd_fs_format (char *cmd, char *output, uint16_t len)
 {
@@ -173,6 +189,9 @@ parse_cmd_fs_inspect_inode (char *cmd, char *output, uint16_t len)
   -- Ethersex META --
   block([[DataFlash]])
   ecmd_feature(df_status, "df status",, Display internal status.)
+  ecmd_ifdef(VFS_DF_PAGEMAP_SUPPORT)
+    ecmd_feature(df_stats, "df stats",, Show page lookups of open files and the flash reads spent on them.)
+  ecmd_endif()
 
   ecmd_feature(fs_format, "fs format",, Format the filesystem.)
   ecmd_feature(fs_list, "fs list",, List the directory.)
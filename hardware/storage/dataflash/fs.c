@@ -115,7 +115,11 @@ typedef struct {
 } PACKED fs_inodetable_t;
 
 /* local prototypes */
-
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+static void fs_inode_cache_fill(fs_t *fs);
+static void fs_inode_cache_put(fs_t *fs, fs_inode_t inode);
+static void fs_inode_cache_drop(fs_t *fs, fs_inode_t inode);
+#endif
 
 
 /* public functions */
@@ -136,10 +140,18 @@ fs_status_t fs_init(void)
      * represents 8 pages, if a bit is set, this page is known as free, so
      * initialilly fill buffer 2 with 0xff's */
 
-    uint8_t b = 0xff;
+    uint8_t b[16];
+    memset(b, 0xff, sizeof(b));
 
-    for (uint16_t i = 0; i < DF_PAGESIZE; i++)
-        df_buf_write(fs.chip, DF_BUF2, &b, i, 1);
+    for (uint16_t i = 0; i < DF_PAGESIZE; i += sizeof(b))
+        df_buf_write(fs.chip, DF_BUF2, b, i, sizeof(b));
+
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+    /* every group may contain free pages, no free inodes known yet */
+    memset(fs.free_groups, 0xff, sizeof(fs.free_groups));
+    fs.free_inodes_count = 0;
+    fs.inode_limit = 0;
+#endif
 
     /* scan for root node, if none could be founde, create one in page 0 */
     fs_status_t ret = fs_scan(&fs);
@@ -1110,6 +1122,58 @@ fs_status_t fs_format(fs_t *fs)
 
 }
 
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+df_page_t fs_new_page(fs_t *fs)
+{
+
+    df_page_t start = (fs->last_free + 1) % DF_PAGES;
+    uint8_t group = start / FS_GROUP_PAGES;
+    uint8_t map[FS_GROUP_PAGES / 8];
+
+    /* only look at groups which may contain a free page, each with a single
+     * read from BUF2.  the group of the start page is visited twice, the
+     * second time for the pages below start after wrapping around */
+    for (uint8_t n = 0; n <= DF_PAGES / FS_GROUP_PAGES;
+         n++, group = (group + 1) % (DF_PAGES / FS_GROUP_PAGES)) {
+
+        if (!(fs->free_groups[group / 8] & _BV(group % 8)))
+            continue;
+
+        df_buf_read(fs->chip, DF_BUF2, map, group * sizeof(map), sizeof(map));
+
+        uint8_t any = 0;
+
+        for (uint8_t i = 0; i < sizeof(map); i++) {
+            if (map[i] == 0)
+                continue;
+
+            any = 1;
+
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                df_page_t page = group * FS_GROUP_PAGES + i * 8 + bit;
+
+                if (!(map[i] & _BV(bit)) || page == fs->last_free
+                    || (n == 0 && page < start))
+                    continue;
+
+                /* free page is found */
+                fs->last_free = page;
+
+                return page;
+            }
+        }
+
+        /* group is completely used, don't read it again until a page in
+         * it gets freed */
+        if (!any)
+            fs->free_groups[group / 8] &= ~_BV(group % 8);
+    }
+
+    /* no free page could be found */
+    return 0xffff;
+
+}
+#else
 df_page_t fs_new_page(fs_t *fs)
 {
 
@@ -1132,10 +1196,28 @@ df_page_t fs_new_page(fs_t *fs)
     }
 
 }
+#endif
 
 fs_inode_t fs_new_inode(fs_t *fs)
 {
 
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+    if (fs->free_inodes_count == 0)
+        fs_inode_cache_fill(fs);
+
+    if (fs->free_inodes_count == 0)
+        return 0xffff;
+
+    /* return the lowest free inode, it stays in the cache until it is
+     * actually used in the inode table */
+    fs_inode_t inode = fs->free_inodes[0];
+
+    for (uint8_t i = 1; i < fs->free_inodes_count; i++)
+        if (fs->free_inodes[i] < inode)
+            inode = fs->free_inodes[i];
+
+    return inode;
+#else
     /* sequentially check inodes, until a free one can be found */
     for (uint8_t i = 0; i < FS_ROOTNODE_INODETABLE_SIZE; i++) {
         df_page_t page = fs_inodetable(fs, i);
@@ -1156,9 +1238,93 @@ fs_inode_t fs_new_inode(fs_t *fs)
 
     /* else return 0xffff */
     return 0xffff;
+#endif
 
 }
 
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+/* the cache holds all free inodes below fs->inode_limit.  refill it by
+ * scanning the inode tables from there on, FS_INODE_CHUNK entries per
+ * flash read */
+static void fs_inode_cache_fill(fs_t *fs)
+{
+
+    fs_inodetable_node_t chunk[FS_INODE_CHUNK];
+    fs_inode_t inode = fs->inode_limit & ~(FS_INODE_CHUNK - 1);
+    uint8_t table = 0xff;
+    df_page_t page = 0;
+
+    for (; inode < FS_INODES; inode += FS_INODE_CHUNK) {
+
+        if (inode / FS_INODES_PER_TABLE != table) {
+            table = inode / FS_INODES_PER_TABLE;
+            page = fs_inodetable(fs, table);
+        }
+
+        df_flash_read(fs->chip, page, chunk,
+                FS_DATA_OFFSET + (inode % FS_INODES_PER_TABLE) * sizeof(fs_inodetable_node_t),
+                sizeof(chunk));
+
+        for (uint8_t i = 0; i < FS_INODE_CHUNK; i++) {
+            if (inode + i < fs->inode_limit || !chunk[i].unused)
+                continue;
+
+            fs->free_inodes[fs->free_inodes_count++] = inode + i;
+
+            if (fs->free_inodes_count == FS_INODE_CACHE) {
+                fs->inode_limit = inode + i + 1;
+                return;
+            }
+        }
+    }
+
+    fs->inode_limit = FS_INODES;
+
+}
+
+/* inode has been freed in the inode table */
+static void fs_inode_cache_put(fs_t *fs, fs_inode_t inode)
+{
+
+    if (inode >= fs->inode_limit)
+        return;
+
+    for (uint8_t i = 0; i < fs->free_inodes_count; i++)
+        if (fs->free_inodes[i] == inode)
+            return;
+
+    if (fs->free_inodes_count == FS_INODE_CACHE) {
+        /* drop the highest inode and lower the limit accordingly */
+        uint8_t max = 0;
+
+        for (uint8_t i = 1; i < FS_INODE_CACHE; i++)
+            if (fs->free_inodes[i] > fs->free_inodes[max])
+                max = i;
+
+        if (fs->free_inodes[max] < inode)
+            fs->inode_limit = inode;
+        else {
+            fs->inode_limit = fs->free_inodes[max];
+            fs->free_inodes[max] = inode;
+        }
+    } else
+        fs->free_inodes[fs->free_inodes_count++] = inode;
+
+}
+
+/* inode has been taken in the inode table */
+static void fs_inode_cache_drop(fs_t *fs, fs_inode_t inode)
+{
+
+    for (uint8_t i = 0; i < fs->free_inodes_count; i++)
+        if (fs->free_inodes[i] == inode) {
+            fs->free_inodes[i] = fs->free_inodes[--fs->free_inodes_count];
+            return;
+        }
+
+}
+#endif
+
 df_page_t fs_inodetable(fs_t *fs, uint8_t tableid)
 {
 
@@ -1197,6 +1363,32 @@ df_page_t fs_page(fs_t *fs, fs_inode_t inode)
 
 }
 
+fs_inode_t fs_next_inode(fs_t *fs, fs_inode_t inode, fs_size_t *size)
+{
+
+    df_page_t pagenum = fs_page(fs, inode);
+
+    if (pagenum == 0xffff) {
+        if (size)
+            *size = 0;
+
+        return 0xffff;
+    }
+
+    /* load page data */
+    fs_page_t page;
+    df_flash_read(fs->chip, pagenum, &page, FS_STRUCTURE_OFFSET, sizeof(fs_page_t));
+
+    if (size)
+        *size = page.size;
+
+    if (page.eof)
+        return 0xffff;
+    else
+        return page.next_inode;
+
+}
+
 void fs_mark(fs_t *fs, df_page_t page, uint8_t is_free)
 {
 
@@ -1207,6 +1399,12 @@ void fs_mark(fs_t *fs, df_page_t page, uint8_t is_free)
            is_free ? "free" : "used");
 #endif
 
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+    /* groups are only cleared lazily by fs_new_page() */
+    if (is_free)
+        fs->free_groups[page / FS_GROUP_PAGES / 8] |= _BV((page / FS_GROUP_PAGES) % 8);
+#endif
+
     /* load byte first */
     df_buf_read(fs->chip, DF_BUF2, &b, page/8, 1);
 
@@ -1347,7 +1545,18 @@ fs_status_t fs_update_inodetable(fs_t *fs, fs_inode_t inode, df_page_t page)
                  sizeof(df_page_t));
 
     /* increment version and update checksum */
-    return fs_increment(fs);
+    fs_status_t ret = fs_increment(fs);
+
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+    if (ret == FS_OK) {
+        if (page == 0xffff)
+            fs_inode_cache_put(fs, inode);
+        else
+            fs_inode_cache_drop(fs, inode);
+    }
+#endif
+
+    return ret;
 
 }
 
@@ -44,6 +44,12 @@
 
 #define FS_FILENAME 6
 
+/* in-RAM caches, see DATAFLASH_FS_CACHE_SUPPORT */
+#define FS_INODES (FS_ROOTNODE_INODETABLE_SIZE * FS_INODES_PER_TABLE)
+#define FS_GROUP_PAGES 64 /* pages summarized by one bit of fs_t.free_groups */
+#define FS_INODE_CACHE 8 /* number of free inodes kept in fs_t.free_inodes */
+#define FS_INODE_CHUNK 16 /* inode table entries read at once when refilling */
+
 #define noinline __attribute__((noinline))
 
 /* structs */
@@ -69,6 +75,15 @@ typedef struct {
     df_page_t root;
     fs_version_t version;
     df_page_t last_free;
+#ifdef DATAFLASH_FS_CACHE_SUPPORT
+    /* one bit per FS_GROUP_PAGES pages of the BUF2 bitmap, cleared if none
+     * of these pages is free */
+    uint8_t free_groups[DF_PAGES / FS_GROUP_PAGES / 8];
+    /* all free inodes below inode_limit */
+    fs_inode_t free_inodes[FS_INODE_CACHE];
+    uint8_t free_inodes_count;
+    fs_inode_t inode_limit;
+#endif
 } fs_t;
 
 /* prototypes */
@@ -92,6 +107,7 @@ df_page_t noinline fs_new_page(fs_t *fs); /* return an empty (=unused) page or 0
 fs_inode_t noinline fs_new_inode(fs_t *fs); /* return an empty (=unused) inode or 0xffff if none could be found */
 df_page_t noinline fs_inodetable(fs_t *fs, uint8_t tableid); /* return the page this inodetable lives in */
 df_page_t noinline fs_page(fs_t *fs, fs_inode_t inode); /* get the page this inode points to */
+fs_inode_t noinline fs_next_inode(fs_t *fs, fs_inode_t inode, fs_size_t *size); /* get the inode of the next page of a file (0xffff at eof) and the size of this one */
 void noinline fs_mark(fs_t *fs, df_page_t page, uint8_t free); /* mark page as used or free (cache in BUF2) */
 #define fs_mark_free(fs, page) fs_mark(fs, page, 1)
 #define fs_mark_used(fs, page) fs_mark(fs, page, 0)
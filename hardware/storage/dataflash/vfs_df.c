@@ -23,6 +23,89 @@
 
 #include "core/vfs/vfs.h"
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+uint32_t vfs_df_seeks;
+uint32_t vfs_df_seek_reads;
+
+/* Forget everything we know about the file, if the filesystem has changed
+   since.  Any write may have moved pages around. */
+static void
+vfs_df_map_check (vfs_file_handle_df_t *df)
+{
+  if (df->version == fs.version && df->map_used)
+    return;
+
+  df->version = fs.version;
+  df->size = -1;
+  df->map[0] = df->inode;
+  df->map_used = 1;
+  df->map_shift = 0;
+  df->cursor_page = 0;
+  df->cursor_inode = df->inode;
+}
+
+/* Return the inode of page PAGE of the file, or of its last page if the
+   file is shorter.  REACHED is set to the index of the returned page and,
+   if we stopped at the end of the file, SIZE to the number of bytes in it.
+   The walk starts at the nearest page that is known already. */
+static fs_inode_t
+vfs_df_walk (vfs_file_handle_df_t *df, uint16_t page, uint16_t *reached,
+	     fs_size_t *size)
+{
+  vfs_df_map_check (df);
+
+  uint16_t slot = page >> df->map_shift;
+  if (slot >= df->map_used)
+    slot = df->map_used - 1;
+
+  uint16_t idx = slot << df->map_shift;
+  fs_inode_t inode = df->map[slot];
+
+  if (df->cursor_page > idx && df->cursor_page <= page)
+    {
+      idx = df->cursor_page;
+      inode = df->cursor_inode;
+    }
+
+  uint32_t reads = df_flash_reads;
+
+  while (idx != page)
+    {
+      fs_inode_t next = fs_next_inode (&fs, inode, size);
+      if (next == 0xffff)
+	break;			/* End of file. */
+
+      inode = next;
+      idx ++;
+
+      /* Remember every (1 << map_shift)th page, if the map is full drop
+	 every other entry and double the stride. */
+      if (idx == (uint16_t) df->map_used << df->map_shift)
+	{
+	  if (df->map_used == VFS_DF_PAGEMAP)
+	    {
+	      for (uint8_t i = 1; i < VFS_DF_PAGEMAP / 2; i ++)
+		df->map[i] = df->map[2 * i];
+
+	      df->map_used = VFS_DF_PAGEMAP / 2;
+	      df->map_shift ++;
+	    }
+
+	  df->map[df->map_used ++] = inode;
+	}
+    }
+
+  vfs_df_seeks ++;
+  vfs_df_seek_reads += df_flash_reads - reads;
+
+  df->cursor_page = idx;
+  df->cursor_inode = inode;
+
+  *reached = idx;
+  return inode;
+}
+#endif	/* VFS_DF_PAGEMAP_SUPPORT */
+
 struct vfs_file_handle_t *
 vfs_df_open (const char *filename)
 {
@@ -38,6 +121,9 @@ vfs_df_open (const char *filename)
   fh->fh_type = VFS_DF;
   fh->u.df.inode = i;
   fh->u.df.offset = 0;
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+  fh->u.df.map_used = 0;
+#endif
 
   return fh;
 }
@@ -51,7 +137,20 @@ vfs_df_close (struct vfs_file_handle_t *fh)
 vfs_size_t
 vfs_df_read (struct vfs_file_handle_t *fh, void *buf, vfs_size_t length)
 {
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+  /* Start reading in the page containing the offset, rather than
+     following the whole page chain from the beginning. */
+  uint16_t page = fh->u.df.offset / FS_DATASIZE, reached;
+  fs_inode_t inode = vfs_df_walk (&fh->u.df, page, &reached, NULL);
+
+  if (reached != page)
+    return 0;			/* Beyond end of file. */
+
+  vfs_size_t ret = fs_read (&fs, inode, buf, fh->u.df.offset % FS_DATASIZE,
+			    length);
+#else
   vfs_size_t ret = fs_read (&fs, fh->u.df.inode, buf, fh->u.df.offset, length);
+#endif
 
   /* Read was successful, update offset. */
   if (ret > 0) fh->u.df.offset += ret;
@@ -79,7 +178,7 @@ uint8_t
 vfs_df_fseek (struct vfs_file_handle_t *fh, vfs_size_t offset,
 	      uint8_t whence)
 {
-  fs_size_t len = fs_size (&fs, fh->u.df.inode);
+  fs_size_t len = vfs_df_size (fh);
   fs_size_t new_pos;
 
   switch (whence)
@@ -136,8 +235,32 @@ vfs_df_unlink (const char *name)
   return fs_remove (&fs, name);
 }
 
+uint32_t
+vfs_df_etag (struct vfs_file_handle_t *fh)
+{
+  /* Every change on the filesystem bumps its version. */
+  return fs.version;
+}
+
 vfs_size_t
 vfs_df_size (struct vfs_file_handle_t *fh)
 {
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+  vfs_file_handle_df_t *df = &fh->u.df;
+  vfs_df_map_check (df);
+
+  if (df->size < 0)
+    {
+      /* All but the last page are filled completely. */
+      uint16_t reached;
+      fs_size_t last;
+
+      vfs_df_walk (df, 0xffff, &reached, &last);
+      df->size = (fs_size_t) reached * FS_DATASIZE + last;
+    }
+
+  return df->size;
+#else
   return fs_size (&fs, fh->u.df.inode);
+#endif
 }
@@ -29,8 +29,28 @@ typedef struct {
   fs_inode_t inode;
   fs_size_t offset;
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+  /* Filesystem version the fields below are valid for. */
+  fs_version_t version;
+  /* Cached file size or -1. */
+  fs_size_t size;
+  /* Inodes of the pages 0, 1 << shift, 2 << shift, ...; the stride is
+     doubled whenever the map runs full. */
+  fs_inode_t map[VFS_DF_PAGEMAP];
+  uint8_t map_used;
+  uint8_t map_shift;
+  /* The page visited last, for sequential access. */
+  uint16_t cursor_page;
+  fs_inode_t cursor_inode;
+#endif
 } vfs_file_handle_df_t;
 
+#ifdef VFS_DF_PAGEMAP_SUPPORT
+/* Page lookups and the flash reads spent on them. */
+extern uint32_t vfs_df_seeks;
+extern uint32_t vfs_df_seek_reads;
+#endif
+
 /* vfs_df_ Prototypes. */
 struct vfs_file_handle_t *vfs_df_open (const char *filename);
 void vfs_df_close (struct vfs_file_handle_t *);
@@ -44,6 +64,7 @@ uint8_t vfs_df_truncate (struct vfs_file_handle_t *, vfs_size_t length);
 struct vfs_file_handle_t *vfs_df_create (const char *name);
 uint8_t vfs_df_unlink (const char *name);
 vfs_size_t vfs_df_size (struct vfs_file_handle_t *);
+uint32_t vfs_df_etag (struct vfs_file_handle_t *);
 
 
 #define VFS_DF_FUNCS {				\
@@ -57,6 +78,8 @@ vfs_size_t vfs_df_size (struct vfs_file_handle_t *);
     vfs_df_create,				\
     vfs_df_unlink,				\
     vfs_df_size,				\
+    NULL, /* pread */				\
+    vfs_df_etag,				\
   }
 
 #endif	/* VFS_DF_H */
@@ -21,6 +21,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <avr/pgmspace.h>
 
 #include "config.h"
@@ -55,6 +56,28 @@ parse_cmd_sd_info(char *cmd, char *output, uint16_t len)
 #endif /* SD_INFO_ECMD_SUPPORT */
 
 
+#ifdef SD_CACHE_ECMD_SUPPORT
+int16_t
+parse_cmd_sd_cache(char *cmd, char *output, uint16_t len)
+{
+  while (*cmd == ' ')
+    cmd++;
+
+  if (strcmp_P(cmd, PSTR("reset")) == 0)
+  {
+    sd_raw_cache_hits = 0;
+    sd_raw_cache_misses = 0;
+    return ECMD_FINAL_OK;
+  }
+
+  return ECMD_FINAL(snprintf_P(output, len,
+                               PSTR("%u blocks, hits %lu, misses %lu"),
+                               SD_RAW_CACHE_BLOCKS,
+                               sd_raw_cache_hits, sd_raw_cache_misses));
+}
+#endif /* SD_CACHE_ECMD_SUPPORT */
+
+
 #ifdef SD_DIR_ECMD_SUPPORT
 int16_t
 parse_cmd_sd_dir(char *cmd, char *output, uint16_t len)
@@ -113,6 +136,9 @@ parse_cmd_sd_rm(char *cmd, char *output, uint16_t len)
   ecmd_ifdef(SD_INFO_ECMD_SUPPORT)
     ecmd_feature(sd_info, "sd info",, List information about SD card.)
   ecmd_endif
+  ecmd_ifdef(SD_CACHE_ECMD_SUPPORT)
+    ecmd_feature(sd_cache, "sd cache",[reset], Show (or reset) hit and miss counters of the SD sector cache.)
+  ecmd_endif
   ecmd_ifdef(SD_DIR_ECMD_SUPPORT)
   ecmd_feature(sd_dir, "sd dir",, List contents of current SD directory.)
   ecmd_endif
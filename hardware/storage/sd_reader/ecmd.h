@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 int16_t parse_cmd_sd_info(char *, char *, uint16_t);
+int16_t parse_cmd_sd_cache(char *, char *, uint16_t);
 int16_t parse_cmd_sd_dir(char *, char *, uint16_t);
 int16_t parse_cmd_sd_mkdir(char *, char *, uint16_t);
 int16_t parse_cmd_sd_rm(char *, char *, uint16_t);
@@ -82,6 +82,13 @@
 #define FAT32_CLUSTER_LAST_MIN 0x0ffffff8
 #define FAT32_CLUSTER_LAST_MAX 0x0fffffff
 
+#define FAT32_FSINFO_LEAD_SIG 0x41615252
+#define FAT32_FSINFO_STRUC_SIG 0x61417272
+/* offset of the structure signature, followed by free count and next free cluster */
+#define FAT32_FSINFO_STRUC_OFFSET 0x1e4
+
+#define FAT_FREE_UNKNOWN ((cluster_t) -1)
+
 #define FAT_DIRENTRY_DELETED 0xe5
 #define FAT_DIRENTRY_LFNLAST (1 << 6)
 #define FAT_DIRENTRY_LFNSEQMASK ((1 << 6) - 1)
@@ -150,6 +157,9 @@ struct fat_header_struct
     offset_t root_dir_offset;
 #if FAT_FAT32_SUPPORT
     cluster_t root_dir_cluster;
+#if FAT_FREE_MAP
+    offset_t fsinfo_offset;
+#endif
 #endif
 };
 
@@ -158,6 +168,14 @@ struct fat_fs_struct
     struct partition_struct* partition;
     struct fat_header_struct header;
     cluster_t cluster_free;
+#if FAT_FREE_MAP
+    /* one bit per group of clusters, cleared if the group is known to be full */
+    uint8_t free_map[(FAT_FREE_MAP + 7) / 8];
+    /* number of clusters per group, a multiple of 16 */
+    cluster_t free_map_group;
+    /* number of free clusters, FAT_FREE_UNKNOWN if not counted yet */
+    cluster_t free_count;
+#endif
 };
 
 struct fat_dir_struct
@@ -193,6 +211,10 @@ static struct fat_dir_struct fat_dir_handles[FAT_DIR_COUNT];
 static uint8_t fat_read_header(struct fat_fs_struct* fs);
 static cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
 static offset_t fat_cluster_offset(const struct fat_fs_struct* fs, cluster_t cluster_num);
+static cluster_t fat_get_file_cluster(struct fat_file_struct* fd, cluster_t file_cluster);
+#if FAT_EXTENT_CACHE
+static void fat_extent_add(struct fat_file_struct* fd, cluster_t file_cluster, cluster_t cluster_num);
+#endif
 static uint8_t fat_dir_entry_read_callback(uint8_t* buffer, offset_t offset, void* p);
 #if FAT_LFN_SUPPORT
 static uint8_t fat_calc_83_checksum(const uint8_t* file_name_83);
@@ -203,7 +225,19 @@ static uint8_t fat_get_fs_free_16_callback(uint8_t* buffer, offset_t offset, voi
 static uint8_t fat_get_fs_free_32_callback(uint8_t* buffer, offset_t offset, void* p);
 #endif
 
+#if FAT_FREE_MAP
+static void fat_free_map_init(struct fat_fs_struct* fs);
+static void fat_free_map_set(struct fat_fs_struct* fs, cluster_t cluster_num);
+#else
+#define fat_free_map_set(fs, cluster_num)
+#endif
+
 #if FAT_WRITE_SUPPORT
+static cluster_t fat_find_free_cluster(struct fat_fs_struct* fs, cluster_t cluster_num);
+static uint8_t fat_write_cluster_entry(const struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t cluster_num_next);
+#if FAT_FSINFO_UPDATE
+static void fat_write_fsinfo(const struct fat_fs_struct* fs);
+#endif
 static cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count);
 static uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
 static uint8_t fat_terminate_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
@@ -272,6 +306,10 @@ struct fat_fs_struct* fat_open(struct partition_struct* partition)
 	SDDEBUG ("fat_open: partition header error.\n");
         return 0;
     }
+
+#if FAT_FREE_MAP
+    fat_free_map_init(fs);
+#endif
     
     return fs;
 }
@@ -315,7 +353,9 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
         return 0;
 
     /* read fat parameters */
-#if FAT_FAT32_SUPPORT
+#if FAT_FAT32_SUPPORT && FAT_FREE_MAP
+    uint8_t buffer[39];
+#elif FAT_FAT32_SUPPORT
     uint8_t buffer[37];
 #else
     uint8_t buffer[25];
@@ -436,6 +476,12 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
                                       (offset_t) fat_copies * sectors_per_fat32 * bytes_per_sector;
 
         header->root_dir_cluster = cluster_root_dir;
+
+#if FAT_FREE_MAP
+        uint16_t fsinfo_sector = read16(&buffer[0x25]);
+        if(fsinfo_sector != 0 && fsinfo_sector != 0xffff)
+            header->fsinfo_offset = partition_offset + (offset_t) fsinfo_sector * bytes_per_sector;
+#endif
     }
 #endif
 
@@ -514,141 +560,197 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
     if(!fs)
         return 0;
 
-    device_read_t device_read = fs->partition->device_read;
-    device_write_t device_write = fs->partition->device_write;
-    offset_t fat_offset = fs->header.fat_offset;
-    cluster_t count_left = count;
+    cluster_t cluster_first = 0;
+    cluster_t cluster_last = 0;
     cluster_t cluster_current = fs->cluster_free;
-    cluster_t cluster_next = 0;
-    cluster_t cluster_count;
-    uint16_t fat_entry16;
-#if FAT_FAT32_SUPPORT
-    uint32_t fat_entry32;
-    uint8_t is_fat32 = (fs->partition->type == PARTITION_TYPE_FAT32);
 
-    if(is_fat32)
-        cluster_count = fs->header.fat_size / sizeof(fat_entry32);
-    else
-#endif
-        cluster_count = fs->header.fat_size / sizeof(fat_entry16);
-
-    fs->cluster_free = 0;
-    for(cluster_t cluster_left = cluster_count; cluster_left > 0; --cluster_left, ++cluster_current)
+    for(; count > 0; --count, ++cluster_current)
     {
-        if(cluster_current < 2 || cluster_current >= cluster_count)
-            cluster_current = 2;
+        /* next fit, continue where the last allocation stopped */
+        cluster_current = fat_find_free_cluster(fs, cluster_current);
+        if(!cluster_current)
+            break;
 
-#if FAT_FAT32_SUPPORT
-        if(is_fat32)
-        {
-            if(!device_read(fat_offset + (offset_t) cluster_current * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
-                return 0;
-        }
-        else
+        /* Allocate the cluster as the end of the new chain,
+         * then link it to its predecessor.
+         */
+        if(!fat_write_cluster_entry(fs, cluster_current, 0))
+            break;
+#if FAT_FREE_MAP
+        if(fs->free_count != FAT_FREE_UNKNOWN)
+            --fs->free_count;
 #endif
-        {
-            if(!device_read(fat_offset + (offset_t) cluster_current * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
-                return 0;
-        }
 
-#if FAT_FAT32_SUPPORT
-        if(is_fat32)
+        if(cluster_last)
         {
-            /* check if this is a free cluster */
-            if(fat_entry32 != HTOL32(FAT32_CLUSTER_FREE))
-                continue;
-
-            /* If we don't need this free cluster for the
-             * current allocation, we keep it in mind for
-             * the next time.
-             */
-            if(count_left == 0)
+            if(!fat_write_cluster_entry(fs, cluster_last, cluster_current))
             {
-                fs->cluster_free = cluster_current;
+                fat_free_clusters(fs, cluster_current);
                 break;
             }
-
-            /* allocate cluster */
-            if(cluster_next == 0)
-                fat_entry32 = HTOL32(FAT32_CLUSTER_LAST_MAX);
-            else
-                fat_entry32 = htol32(cluster_next);
-
-            if(!device_write(fat_offset + (offset_t) cluster_current * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
-                break;
         }
         else
-#endif
         {
-            /* check if this is a free cluster */
-            if(fat_entry16 != HTOL16(FAT16_CLUSTER_FREE))
-                continue;
-
-            /* If we don't need this free cluster for the
-             * current allocation, we keep it in mind for
-             * the next time.
-             */
-            if(count_left == 0)
-            {
-                fs->cluster_free = cluster_current;
-                break;
-            }
-
-            /* allocate cluster */
-            if(cluster_next == 0)
-                fat_entry16 = HTOL16(FAT16_CLUSTER_LAST_MAX);
-            else
-                fat_entry16 = htol16((uint16_t) cluster_next);
-
-            if(!device_write(fat_offset + (offset_t) cluster_current * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
-                break;
+            cluster_first = cluster_current;
         }
 
-        cluster_next = cluster_current;
-        --count_left;
+        cluster_last = cluster_current;
     }
+    fs->cluster_free = cluster_current;
 
     do
     {
-        if(count_left > 0)
+        if(count > 0)
             break;
 
         /* We allocated a new cluster chain. Now join
          * it with the existing one (if any).
          */
-        if(cluster_num >= 2)
-        {
-#if FAT_FAT32_SUPPORT
-            if(is_fat32)
-            {
-                fat_entry32 = htol32(cluster_next);
+        if(cluster_num >= 2 && !fat_write_cluster_entry(fs, cluster_num, cluster_first))
+            break;
 
-                if(!device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
-                    break;
-            }
-            else
+#if FAT_FSINFO_UPDATE
+        fat_write_fsinfo(fs);
 #endif
-            {
-                fat_entry16 = htol16((uint16_t) cluster_next);
-
-                if(!device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
-                    break;
-            }
-        }
-
-        return cluster_next;
+        return cluster_first;
 
     } while(0);
 
     /* No space left on device or writing error.
      * Free up all clusters already allocated.
      */
-    fat_free_clusters(fs, cluster_next);
+    if(cluster_first)
+        fat_free_clusters(fs, cluster_first);
 
     return 0;
 }
 #endif
 
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Searches the FAT for a free cluster.
+ *
+ * The search starts at \c cluster_num and wraps around at the end of
+ * the FAT.  The FAT is read in chunks of 32 bytes.  If FAT_FREE_MAP is
+ * enabled, groups of clusters known to be in use are skipped, and
+ * groups found to be in use are remembered.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ * \param[in] cluster_num The cluster at which to start the search.
+ * \returns The number of a free cluster, or 0 if there is none or on error.
+ */
+cluster_t fat_find_free_cluster(struct fat_fs_struct* fs, cluster_t cluster_num)
+{
+    uint8_t fat[32];
+    uint8_t entry_size = 2;
+#if FAT_FAT32_SUPPORT
+    if(fs->partition->type == PARTITION_TYPE_FAT32)
+        entry_size = 4;
+#endif
+    cluster_t cluster_count = fs->header.fat_size / entry_size;
+    cluster_t chunk = sizeof(fat) / entry_size;
+#if FAT_FREE_MAP
+    cluster_t group_size = fs->free_map_group;
+    cluster_t group = FAT_FREE_UNKNOWN;
+    uint8_t group_whole = 0;
+#endif
+
+    for(cluster_t cluster_left = cluster_count; cluster_left > 0; )
+    {
+        if(cluster_num < 2 || cluster_num >= cluster_count)
+            cluster_num = 2;
+
+        cluster_t cluster_end = (cluster_num & ~(chunk - 1)) + chunk;
+
+#if FAT_FREE_MAP
+        cluster_t group_current = cluster_num / group_size;
+        cluster_t group_end = (group_current + 1) * group_size;
+        if(!(fs->free_map[group_current / 8] & (1 << (group_current % 8))))
+        {
+            /* skip the group, it is known to be in use */
+            cluster_end = group_end;
+        }
+        else
+        {
+            if(group_current != group)
+            {
+                /* a group is found to be in use only if scanned as a whole */
+                group = group_current;
+                group_whole = (cluster_num == (group_current ? group_current * group_size : 2));
+            }
+#endif
+            if(cluster_end > cluster_count)
+                cluster_end = cluster_count;
+
+            /* read the chunk of entries the cluster is in */
+            cluster_t cluster_chunk = cluster_num & ~(chunk - 1);
+            if(!fs->partition->device_read(fs->header.fat_offset + (offset_t) cluster_chunk * entry_size, fat, (cluster_end - cluster_chunk) * entry_size))
+                return 0;
+
+            for(cluster_t i = cluster_num; i < cluster_end; ++i)
+            {
+                uint8_t* entry = &fat[(i - cluster_chunk) * entry_size];
+#if FAT_FAT32_SUPPORT
+                if(entry_size == 4)
+                {
+                    if(read32(entry) == FAT32_CLUSTER_FREE)
+                        return i;
+                }
+                else
+#endif
+                {
+                    if(read16(entry) == FAT16_CLUSTER_FREE)
+                        return i;
+                }
+            }
+
+#if FAT_FREE_MAP
+            if(group_whole && (cluster_end == group_end || cluster_end == cluster_count))
+                fs->free_map[group_current / 8] &= ~(1 << (group_current % 8));
+        }
+#endif
+
+        if(cluster_end > cluster_count)
+            cluster_end = cluster_count;
+        if(cluster_end - cluster_num >= cluster_left)
+            break;
+        cluster_left -= cluster_end - cluster_num;
+        cluster_num = cluster_end;
+    }
+
+    return 0;
+}
+#endif
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Writes the FAT entry of a cluster.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ * \param[in] cluster_num The cluster whose entry to write.
+ * \param[in] cluster_num_next The cluster following it, 0 for the end of the chain.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_write_cluster_entry(const struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t cluster_num_next)
+{
+    offset_t fat_offset = fs->header.fat_offset;
+#if FAT_FAT32_SUPPORT
+    if(fs->partition->type == PARTITION_TYPE_FAT32)
+    {
+        uint32_t fat_entry = cluster_num_next ? htol32(cluster_num_next) : HTOL32(FAT32_CLUSTER_LAST_MAX);
+        return fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+    }
+    else
+#endif
+    {
+        uint16_t fat_entry = cluster_num_next ? htol16((uint16_t) cluster_num_next) : HTOL16(FAT16_CLUSTER_LAST_MAX);
+        return fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+    }
+}
+#endif
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_fs
@@ -704,7 +806,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
             /* free cluster */
             fat_entry = HTOL32(FAT32_CLUSTER_FREE);
-            fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+            if(fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+                fat_free_map_set(fs, cluster_num);
 
             /* We continue in any case here, even if freeing the cluster failed.
              * The cluster is lost, but maybe we can still free up some later ones.
@@ -738,7 +841,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
             /* free cluster */
             fat_entry = HTOL16(FAT16_CLUSTER_FREE);
-            fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry));
+            if(fs->partition->device_write(fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+                fat_free_map_set(fs, cluster_num);
 
             /* We continue in any case here, even if freeing the cluster failed.
              * The cluster is lost, but maybe we can still free up some later ones.
@@ -748,6 +852,10 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
         }
     }
 
+#if FAT_FSINFO_UPDATE
+    fat_write_fsinfo(fs);
+#endif
+
     return 1;
 }
 #endif
@@ -974,6 +1082,9 @@ struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat
     fd->fs = fs;
     fd->pos = 0;
     fd->pos_cluster = dir_entry->cluster;
+#if FAT_EXTENT_CACHE
+    fd->extent_count = 0;
+#endif
 
     return fd;
 }
@@ -1046,14 +1157,9 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
 
         if(fd->pos)
         {
-            uint32_t pos = fd->pos;
-            while(pos >= cluster_size)
-            {
-                pos -= cluster_size;
-                cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
-                if(!cluster_num)
-                    return -1;
-            }
+            cluster_num = fat_get_file_cluster(fd, fd->pos / cluster_size);
+            if(!cluster_num)
+                return -1;
         }
     }
     
@@ -1078,7 +1184,11 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
         if(first_cluster_offset + copy_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
+#if FAT_EXTENT_CACHE
+            if((cluster_num = fat_get_file_cluster(fd, fd->pos / cluster_size)))
+#else
             if((cluster_num = fat_get_next_cluster(fd->fs, cluster_num)))
+#endif
             {
                 first_cluster_offset = 0;
             }
@@ -1142,27 +1252,33 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
             }
         }
 
-        if(fd->pos)
+        if(fd->pos >= cluster_size)
         {
-            uint32_t pos = fd->pos;
-            cluster_t cluster_num_next;
-            while(pos >= cluster_size)
-            {
-                pos -= cluster_size;
-                cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
-                if(!cluster_num_next)
-                {
-                    if(pos != 0)
-                        return -1; /* current file position points beyond end of file */
+            cluster_t file_cluster = fd->pos / cluster_size;
+            cluster_num = fat_get_file_cluster(fd, file_cluster - 1);
+            if(!cluster_num)
+                return -1;
 
-                    /* the file exactly ends on a cluster boundary, and we append to it */
-                    cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
-                    if(!cluster_num_next)
-                        return 0;
-                }
+#if FAT_EXTENT_CACHE
+            cluster_t cluster_num_next = fat_get_file_cluster(fd, file_cluster);
+#else
+            cluster_t cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
+#endif
+            if(!cluster_num_next)
+            {
+                if(first_cluster_offset != 0)
+                    return -1; /* current file position points beyond end of file */
 
-                cluster_num = cluster_num_next;
+                /* the file exactly ends on a cluster boundary, and we append to it */
+                cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+                if(!cluster_num_next)
+                    return 0;
+#if FAT_EXTENT_CACHE
+                fat_extent_add(fd, file_cluster, cluster_num_next);
+#endif
             }
+
+            cluster_num = cluster_num_next;
         }
     }
     
@@ -1187,10 +1303,20 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         if(first_cluster_offset + write_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
+#if FAT_EXTENT_CACHE
+            cluster_t cluster_num_next = fat_get_file_cluster(fd, fd->pos / cluster_size);
+#else
             cluster_t cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
+#endif
             if(!cluster_num_next && buffer_left > 0)
+            {
                 /* we reached the last cluster, append a new one */
                 cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+#if FAT_EXTENT_CACHE
+                if(cluster_num_next)
+                    fat_extent_add(fd, fd->pos / cluster_size, cluster_num_next);
+#endif
+            }
             if(!cluster_num_next)
             {
                 fd->pos_cluster = 0;
@@ -1333,6 +1459,11 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
     uint16_t cluster_size = fd->fs->header.cluster_size;
     uint32_t size_new = size;
 
+#if FAT_EXTENT_CACHE
+    /* the cluster chain is going to change */
+    fd->extent_count = 0;
+#endif
+
     do
     {
         if(cluster_num == 0 && size_new == 0)
@@ -1403,6 +1534,127 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
 }
 #endif
 
+/**
+ * \ingroup fat_file
+ * Determines the disk cluster holding a cluster of a file.
+ *
+ * Follows the cluster chain starting at the first cluster of the file
+ * or, if FAT_EXTENT_CACHE is enabled, at the closest run of clusters
+ * already known to the file handle.
+ *
+ * \param[in] fd The file handle of the file.
+ * \param[in] file_cluster The index of the cluster within the file.
+ * \returns The disk cluster number, or 0 if the file is shorter or on error.
+ */
+cluster_t fat_get_file_cluster(struct fat_file_struct* fd, cluster_t file_cluster)
+{
+    cluster_t cluster_num = fd->dir_entry.cluster;
+    cluster_t i = 0;
+
+    if(!cluster_num)
+        return 0;
+
+#if FAT_EXTENT_CACHE
+    /* find the last run starting at or before the cluster */
+    uint8_t n = fd->extent_count;
+    while(n > 0 && fd->extents[n - 1].file_cluster > file_cluster)
+        --n;
+
+    if(n > 0)
+    {
+        const struct fat_extent_struct* extent = &fd->extents[n - 1];
+        i = file_cluster - extent->file_cluster;
+        if(i < extent->length)
+            return extent->cluster_num + i;
+
+        /* continue from the end of the run */
+        i = extent->file_cluster + extent->length - 1;
+        cluster_num = extent->cluster_num + extent->length - 1;
+    }
+    else
+    {
+        fat_extent_add(fd, 0, cluster_num);
+    }
+#endif
+
+    while(i < file_cluster)
+    {
+        cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
+        if(!cluster_num)
+            return 0;
+
+        ++i;
+#if FAT_EXTENT_CACHE
+        fat_extent_add(fd, i, cluster_num);
+#endif
+    }
+
+    return cluster_num;
+}
+
+#if FAT_EXTENT_CACHE
+/**
+ * \ingroup fat_file
+ * Remembers the disk cluster of a cluster of a file.
+ *
+ * Extends the run the preceding cluster belongs to if the cluster
+ * directly follows it on disk, and starts a new run otherwise.  If
+ * all runs are in use, the shortest one is dropped.
+ *
+ * \param[in] fd The file handle of the file.
+ * \param[in] file_cluster The index of the cluster within the file.
+ * \param[in] cluster_num The disk cluster number of the cluster.
+ */
+void fat_extent_add(struct fat_file_struct* fd, cluster_t file_cluster, cluster_t cluster_num)
+{
+    struct fat_extent_struct* extents = fd->extents;
+    uint8_t count = fd->extent_count;
+
+    /* find the position of the cluster, after all runs starting before it */
+    uint8_t i = count;
+    while(i > 0 && extents[i - 1].file_cluster >= file_cluster)
+        --i;
+
+    if(i > 0)
+    {
+        struct fat_extent_struct* prev = &extents[i - 1];
+        cluster_t end = prev->file_cluster + prev->length;
+        if(end == file_cluster && prev->cluster_num + prev->length == cluster_num)
+        {
+            /* the run goes on */
+            ++prev->length;
+            return;
+        }
+        if(end > file_cluster)
+            return;
+    }
+    if(i < count && extents[i].file_cluster == file_cluster)
+        return;
+
+    if(count >= FAT_EXTENT_CACHE)
+    {
+        /* drop the shortest run, but not the one preceding the cluster */
+        uint8_t victim = (i == 1);
+        for(uint8_t j = victim + 1; j < count; ++j)
+        {
+            if(j + 1 != i && extents[j].length < extents[victim].length)
+                victim = j;
+        }
+
+        --count;
+        memmove(&extents[victim], &extents[victim + 1], (count - victim) * sizeof(*extents));
+        if(victim < i)
+            --i;
+    }
+
+    memmove(&extents[i + 1], &extents[i], (count - i) * sizeof(*extents));
+    extents[i].file_cluster = file_cluster;
+    extents[i].cluster_num = cluster_num;
+    extents[i].length = 1;
+    fd->extent_count = count + 1;
+}
+#endif
+
 /**
  * \ingroup fat_dir
  * Opens a directory.
@@ -2507,11 +2759,16 @@ offset_t fat_get_fs_size(const struct fat_fs_struct* fs)
  * \param[in] fs The filesystem on which to operate.
  * \returns 0 on failure, the free filesystem space in bytes otherwise.
  */
-offset_t fat_get_fs_free(const struct fat_fs_struct* fs)
+offset_t fat_get_fs_free(struct fat_fs_struct* fs)
 {
     if(!fs)
         return 0;
 
+#if FAT_FREE_MAP
+    if(fs->free_count != FAT_FREE_UNKNOWN)
+        return (offset_t) fs->free_count * fs->header.cluster_size;
+#endif
+
     uint8_t fat[32];
     struct fat_usage_count_callback_arg count_arg;
     count_arg.cluster_count = 0;
@@ -2545,6 +2802,12 @@ offset_t fat_get_fs_free(const struct fat_fs_struct* fs)
         fat_size -= length;
     }
 
+#if FAT_FREE_MAP
+    fs->free_count = count_arg.cluster_count;
+#if FAT_FSINFO_UPDATE
+    fat_write_fsinfo(fs);
+#endif
+#endif
     return (offset_t) count_arg.cluster_count * fs->header.cluster_size;
 }
 
@@ -2588,3 +2851,96 @@ uint8_t fat_get_fs_free_32_callback(uint8_t* buffer, offset_t offset, void* p)
 }
 #endif
 
+
+#if DOXYGEN || FAT_FREE_MAP
+/**
+ * \ingroup fat_fs
+ * Initializes the free cluster map of a filesystem.
+ *
+ * All groups of clusters are assumed to contain free clusters until
+ * fat_find_free_cluster() finds them in use.  On FAT32, the next free
+ * cluster is taken from the FSInfo sector if it is valid.  The free
+ * cluster count only if FSInfo updates are enabled, otherwise we
+ * would trust a count our own earlier writes have left stale.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ */
+void fat_free_map_init(struct fat_fs_struct* fs)
+{
+    cluster_t cluster_count = fs->header.fat_size / 2;
+#if FAT_FAT32_SUPPORT
+    if(fs->partition->type == PARTITION_TYPE_FAT32)
+        cluster_count = fs->header.fat_size / 4;
+#endif
+
+    /* groups consist of a multiple of 16 clusters, i.e. of 32 byte FAT chunks */
+    fs->free_map_group = ((cluster_count + FAT_FREE_MAP - 1) / FAT_FREE_MAP + 15) & ~(cluster_t) 15;
+    memset(fs->free_map, 0xff, sizeof(fs->free_map));
+    fs->free_count = FAT_FREE_UNKNOWN;
+
+#if FAT_FAT32_SUPPORT
+    offset_t fsinfo_offset = fs->header.fsinfo_offset;
+    if(!fsinfo_offset)
+        return;
+
+    uint8_t buffer[12];
+    if(!fs->partition->device_read(fsinfo_offset, buffer, 4) ||
+       read32(buffer) != FAT32_FSINFO_LEAD_SIG ||
+       !fs->partition->device_read(fsinfo_offset + FAT32_FSINFO_STRUC_OFFSET, buffer, sizeof(buffer)) ||
+       read32(&buffer[0]) != FAT32_FSINFO_STRUC_SIG)
+    {
+        fs->header.fsinfo_offset = 0;
+        return;
+    }
+
+    /* both values are hints, ignore them if they are out of range */
+    uint32_t free_count = read32(&buffer[4]);
+    uint32_t cluster_next = read32(&buffer[8]);
+#if FAT_FSINFO_UPDATE
+    if(free_count <= cluster_count - 2)
+        fs->free_count = free_count;
+#else
+    (void) free_count;
+#endif
+    if(cluster_next >= 2 && cluster_next < cluster_count)
+        fs->cluster_free = cluster_next;
+#endif
+}
+
+/**
+ * \ingroup fat_fs
+ * Accounts for a cluster which has been freed.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ * \param[in] cluster_num The cluster which has been freed.
+ */
+void fat_free_map_set(struct fat_fs_struct* fs, cluster_t cluster_num)
+{
+    cluster_t group = cluster_num / fs->free_map_group;
+    fs->free_map[group / 8] |= 1 << (group % 8);
+
+    if(fs->free_count != FAT_FREE_UNKNOWN)
+        ++fs->free_count;
+}
+#endif
+
+#if DOXYGEN || FAT_FSINFO_UPDATE
+/**
+ * \ingroup fat_fs
+ * Writes the free cluster count and the next free cluster to the
+ * FAT32 FSInfo sector.
+ *
+ * \param[in] fs The filesystem on which to operate.
+ */
+void fat_write_fsinfo(const struct fat_fs_struct* fs)
+{
+    if(!fs->header.fsinfo_offset)
+        return;
+
+    uint32_t fsinfo[2];
+    fsinfo[0] = fs->free_count == FAT_FREE_UNKNOWN ? 0xffffffff : htol32(fs->free_count);
+    fsinfo[1] = fs->cluster_free ? htol32(fs->cluster_free) : 0xffffffff;
+
+    fs->partition->device_write(fs->header.fsinfo_offset + FAT32_FSINFO_STRUC_OFFSET + 4, (uint8_t*) fsinfo, sizeof(fsinfo));
+}
+#endif
@@ -89,12 +89,33 @@ struct fat_dir_entry_struct
     offset_t entry_offset;
 };
 
+#if FAT_EXTENT_CACHE
+/**
+ * \ingroup fat_file
+ * Describes a run of contiguous clusters of a file.
+ */
+struct fat_extent_struct
+{
+    /** The index of the run's first cluster within the file. */
+    cluster_t file_cluster;
+    /** The disk cluster number of the run's first cluster. */
+    cluster_t cluster_num;
+    /** The number of clusters in the run. */
+    cluster_t length;
+};
+#endif
+
 struct fat_file_struct
 {
     struct fat_fs_struct* fs;
     struct fat_dir_entry_struct dir_entry;
     offset_t pos;
     cluster_t pos_cluster;
+#if FAT_EXTENT_CACHE
+    /* runs of the cluster chain known so far, sorted by file_cluster */
+    struct fat_extent_struct extents[FAT_EXTENT_CACHE];
+    uint8_t extent_count;
+#endif
 };
 
 struct fat_fs_struct* fat_open(struct partition_struct* partition);
@@ -125,7 +146,7 @@ void fat_get_file_modification_time(const struct fat_dir_entry_struct* dir_entry
 uint8_t fat_get_dir_entry_of_path(struct fat_fs_struct* fs, const char* path, struct fat_dir_entry_struct* dir_entry);
 
 offset_t fat_get_fs_size(const struct fat_fs_struct* fs);
-offset_t fat_get_fs_free(const struct fat_fs_struct* fs);
+offset_t fat_get_fs_free(struct fat_fs_struct* fs);
 
 extern struct fat_fs_struct* fat_fs;
 extern struct fat_dir_struct* sd_cwd;
@@ -71,6 +71,52 @@ extern "C"
  */
 #define FAT_DELAY_DIRENTRY_UPDATE 0
 
+/**
+ * \ingroup fat_config
+ * Controls the cluster chain cache of file handles.
+ *
+ * Set to the number of contiguous cluster runs each file handle
+ * remembers while following the cluster chain, or to 0 to disable
+ * the cache.  Seeks then start walking the chain at the closest
+ * known run instead of the first cluster of the file.
+ */
+#ifdef SD_EXTENT_CACHE_SUPPORT
+#define FAT_EXTENT_CACHE SD_EXTENT_CACHE_RUNS
+#else
+#define FAT_EXTENT_CACHE 0
+#endif
+
+/**
+ * \ingroup fat_config
+ * Controls the free cluster map.
+ *
+ * Set to the number of groups the clusters are divided into, or to 0
+ * to disable the map.  The map remembers groups without free clusters,
+ * so that the allocator skips them, and keeps the number of free
+ * clusters once it is known.
+ */
+#ifdef SD_FREE_MAP_SUPPORT
+#define FAT_FREE_MAP SD_FREE_MAP_GROUPS
+#else
+#define FAT_FREE_MAP 0
+#endif
+
+/**
+ * \ingroup fat_config
+ * Controls updates of the FAT32 FSInfo sector.
+ *
+ * Set to 1 to write the free cluster count and the next free cluster
+ * to the FSInfo sector whenever clusters are allocated or freed.
+ * The next free cluster hint of the FSInfo sector is always read when the
+ * free cluster map is enabled, the free cluster count only if it is kept
+ * up to date.
+ */
+#if defined(SD_FSINFO_UPDATE_SUPPORT) && FAT_FREE_MAP && FAT_FAT32_SUPPORT && FAT_WRITE_SUPPORT
+#define FAT_FSINFO_UPDATE 1
+#else
+#define FAT_FSINFO_UPDATE 0
+#endif
+
 /**
  * \ingroup fat_config
  * Determines the function used for retrieving current date and time.
@@ -120,6 +166,10 @@ void get_datetime(uint16_t* year, uint8_t* month, uint8_t* day, uint8_t* hour, u
     typedef uint16_t cluster_t;
 #endif
 
+#if FAT_EXTENT_CACHE == 1
+#error "SD_EXTENT_CACHE_RUNS must be at least 2"
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -145,19 +145,39 @@
 #define SD_RAW_SPEC_SDHC 2
 
 #if !SD_RAW_SAVE_RAM
-/* static data buffer for acceleration */
-static uint8_t raw_block[512];
-/* offset where the data within raw_block lies on the card */
-static offset_t raw_block_address;
+/* static data buffers for acceleration */
+static uint8_t raw_block[SD_RAW_CACHE_BLOCKS][512];
+/* offsets where the data within raw_block lies on the card */
+static offset_t raw_block_address[SD_RAW_CACHE_BLOCKS];
 #if SD_RAW_WRITE_BUFFERING
-/* flag to remember if raw_block was written to the card */
-static uint8_t raw_block_written;
+/* flags to remember if raw_block was written to the card */
+static uint8_t raw_block_written[SD_RAW_CACHE_BLOCKS];
 #endif
+#if SD_RAW_CACHE_BLOCKS > 1
+/* indices into raw_block, most recently used first */
+static uint8_t raw_block_lru[SD_RAW_CACHE_BLOCKS];
+#endif
+/* returned by sd_raw_cache_get() on failure */
+#define SD_RAW_CACHE_NONE 0xff
+#endif
+
+#ifdef SD_CACHE_SUPPORT
+uint32_t sd_raw_cache_hits;
+uint32_t sd_raw_cache_misses;
 #endif
 
 /* card type state */
 static uint8_t sd_raw_card_type;
 
+#if SD_RAW_STREAMING
+/* command of the open multiple block transfer, 0 if there is none */
+static uint8_t sd_raw_stream_cmd;
+/* card address of the block the transfer continues with */
+static offset_t sd_raw_stream_next;
+/* set on each access, cleared by sd_raw_stream_periodic() */
+static uint8_t sd_raw_stream_used;
+#endif
+
 /* private helper functions */
 #if 0
 static void sd_raw_send_byte(uint8_t b);
@@ -168,6 +188,17 @@ static uint8_t sd_raw_rec_byte(void);
 #define sd_raw_rec_byte() spi_send(0xff)
 #endif
 static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
+static uint8_t sd_raw_read_block(offset_t block_address, uint8_t* buffer, uint16_t block_offset, uint16_t read_length);
+#if SD_RAW_WRITE_SUPPORT
+static uint8_t sd_raw_write_block(offset_t block_address, const uint8_t* buffer);
+#endif
+#if !SD_RAW_SAVE_RAM
+static uint8_t sd_raw_cache_get(offset_t block_address, uint8_t load);
+#endif
+#if SD_RAW_STREAMING
+static uint8_t sd_raw_stream_open(uint8_t command, offset_t block_address);
+static void sd_raw_stream_stop(void);
+#endif
 
 
 /**
@@ -207,6 +238,9 @@ uint8_t sd_raw_init(void)
 
     /* initialization procedure */
     sd_raw_card_type = 0;
+#if SD_RAW_STREAMING
+    sd_raw_stream_cmd = 0;
+#endif
     
     if(!sd_raw_available())
     {
@@ -340,11 +374,17 @@ uint8_t sd_raw_init(void)
 
 #if !SD_RAW_SAVE_RAM
     /* the first block is likely to be accessed first, so precache it here */
-    raw_block_address = (offset_t) -1;
+    for(uint8_t i = 0; i < SD_RAW_CACHE_BLOCKS; ++i)
+    {
+        raw_block_address[i] = (offset_t) -1;
 #if SD_RAW_WRITE_BUFFERING
-    raw_block_written = 1;
+        raw_block_written[i] = 1;
+#endif
+#if SD_RAW_CACHE_BLOCKS > 1
+        raw_block_lru[i] = i;
 #endif
-    if(!sd_raw_read(0, raw_block, sizeof(raw_block)))
+    }
+    if(sd_raw_cache_get(0, 1) == SD_RAW_CACHE_NONE)
         return 0;
 #endif
 
@@ -436,6 +476,13 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
         case CMD_SEND_IF_COND:
            sd_raw_send_byte(0x87);
            break;
+#if SD_RAW_STREAMING
+        case CMD_STOP_TRANSMISSION:
+           sd_raw_send_byte(0xff);
+           /* skip stuff byte, data of the aborted block may follow */
+           sd_raw_rec_byte();
+           break;
+#endif
         default:
            sd_raw_send_byte(0xff);
            break;
@@ -445,7 +492,12 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
     for(uint8_t i = 0; i < 10; ++i)
     {
         response = sd_raw_rec_byte();
+#if SD_RAW_STREAMING
+        /* R1 always has the MSB cleared */
+        if(!(response & 0x80))
+#else
         if(response != 0xff)
+#endif
             break;
     }
 
@@ -476,92 +528,168 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
         if(read_length > length)
             read_length = length;
         
-#if !SD_RAW_SAVE_RAM
-        /* check if the requested data is cached */
-        if(block_address != raw_block_address)
-#endif
-        {
-#if SD_RAW_WRITE_BUFFERING
-            if(!sd_raw_sync())
-                return 0;
+#if SD_RAW_SAVE_RAM
+        if(!sd_raw_read_block(block_address, buffer, block_offset, read_length))
+            return 0;
+#else
+        /* fetch the block through the cache */
+        uint8_t slot = sd_raw_cache_get(block_address, 1);
+        if(slot == SD_RAW_CACHE_NONE)
+            return 0;
+
+        memcpy(buffer, raw_block[slot] + block_offset, read_length);
 #endif
+        buffer += read_length;
+        length -= read_length;
+        offset += read_length;
+    }
 
-            /* address card */
-            select_card();
+    return 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Reads a single block from the card.
+ *
+ * Unless SD_RAW_SAVE_RAM is set, the whole block is read and
+ * \c block_offset and \c read_length are ignored.
+ *
+ * \param[in] block_address The card address of the block.
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] block_offset The offset of the data within the block.
+ * \param[in] read_length The number of bytes to read, up to the block border.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_read_block(offset_t block_address, uint8_t* buffer, uint16_t block_offset, uint16_t read_length)
+{
+#if SD_RAW_STREAMING
+    /* address card, continue or start multiple block read */
+    if(!sd_raw_stream_open(CMD_READ_MULTIPLE_BLOCK, block_address))
+        return 0;
+#else
+    /* address card */
+    select_card();
 
-            /* send single block request */
+    /* send single block request */
 #if SD_RAW_SDHC
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+    if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
 #else
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
+    if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
+#endif
+    {
+        unselect_card();
+        return 0;
+    }
 #endif
-            {
-                unselect_card();
-                return 0;
-            }
 
-            /* wait for data block (start byte 0xfe) */
+    /* wait for data block (start byte 0xfe) */
 #ifdef SD_READ_TIMEOUT
-            uint16_t timeout = 20000;
+    uint16_t timeout = 20000;
 
-            while(sd_raw_rec_byte() != 0xfe && timeout > 0)
-                timeout --;
+    while(sd_raw_rec_byte() != 0xfe && timeout > 0)
+        timeout --;
 
-            if (timeout == 0)
-            {
-                SDDEBUGRAW ("read timeout reached!\n");
-                unselect_card();
-                return 0;
-            }
+    if (timeout == 0)
+    {
+        SDDEBUGRAW ("read timeout reached!\n");
+        unselect_card();
+#if SD_RAW_STREAMING
+        sd_raw_stream_stop();
+#endif
+        return 0;
+    }
 #else
-            while(sd_raw_rec_byte() != 0xfe);
+    while(sd_raw_rec_byte() != 0xfe);
 #endif
 
+    /* read byte block */
 #if SD_RAW_SAVE_RAM
-            /* read byte block */
-            uint16_t read_to = block_offset + read_length;
-            for(uint16_t i = 0; i < 512; ++i)
-            {
-                uint8_t b = sd_raw_rec_byte();
-                if(i >= block_offset && i < read_to)
-                    *buffer++ = b;
-            }
+    uint16_t read_to = block_offset + read_length;
+    for(uint16_t i = 0; i < 512; ++i)
+    {
+        uint8_t b = sd_raw_rec_byte();
+        if(i >= block_offset && i < read_to)
+            *buffer++ = b;
+    }
 #else
-            /* read byte block */
-            uint8_t* cache = raw_block;
-            for(uint16_t i = 0; i < 512; ++i)
-                *cache++ = sd_raw_rec_byte();
-            raw_block_address = block_address;
-
-            memcpy(buffer, raw_block + block_offset, read_length);
-            buffer += read_length;
+    for(uint16_t i = 0; i < 512; ++i)
+        *buffer++ = sd_raw_rec_byte();
 #endif
-            
-            /* read crc16 */
-            sd_raw_rec_byte();
-            sd_raw_rec_byte();
-            
-            /* deaddress card */
-            unselect_card();
 
-            /* let card some time to finish */
-            sd_raw_rec_byte();
-        }
+    /* read crc16 */
+    sd_raw_rec_byte();
+    sd_raw_rec_byte();
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+
+    return 1;
+}
+
 #if !SD_RAW_SAVE_RAM
-        else
-        {
-            /* use cached data */
-            memcpy(buffer, raw_block + block_offset, read_length);
-            buffer += read_length;
-        }
+/**
+ * \ingroup sd_raw
+ * Looks up the block at \c block_address in the access buffers.
+ *
+ * On a miss, the least recently used buffer is written back if it
+ * holds unwritten data and is then reused for the block.  The block
+ * is read from the card only if \c load is set, i.e. if the caller
+ * is not going to overwrite it completely.
+ *
+ * \param[in] block_address The card address of the block.
+ * \param[in] load Whether the block's content is needed.
+ * \returns The index into raw_block, SD_RAW_CACHE_NONE on failure.
+ */
+uint8_t sd_raw_cache_get(offset_t block_address, uint8_t load)
+{
+    uint8_t slot;
+#if SD_RAW_CACHE_BLOCKS > 1
+    /* search the buffers, the least recently used one is taken on a miss */
+    uint8_t i;
+    for(i = 0; i < SD_RAW_CACHE_BLOCKS - 1; ++i)
+        if(raw_block_address[raw_block_lru[i]] == block_address)
+            break;
+    slot = raw_block_lru[i];
+
+    /* mark it as most recently used */
+    for(; i > 0; --i)
+        raw_block_lru[i] = raw_block_lru[i - 1];
+    raw_block_lru[0] = slot;
+#else
+    slot = 0;
 #endif
 
-        length -= read_length;
-        offset += read_length;
+    if(raw_block_address[slot] == block_address)
+    {
+#ifdef SD_CACHE_SUPPORT
+        ++sd_raw_cache_hits;
+#endif
+        return slot;
     }
+#ifdef SD_CACHE_SUPPORT
+    ++sd_raw_cache_misses;
+#endif
 
-    return 1;
+#if SD_RAW_WRITE_BUFFERING
+    if(!raw_block_written[slot])
+    {
+        if(!sd_raw_write_block(raw_block_address[slot], raw_block[slot]))
+            return SD_RAW_CACHE_NONE;
+        raw_block_written[slot] = 1;
+    }
+#endif
+
+    raw_block_address[slot] = (offset_t) -1;
+    if(load && !sd_raw_read_block(block_address, raw_block[slot], 0, 512))
+        return SD_RAW_CACHE_NONE;
+    raw_block_address[slot] = block_address;
+
+    return slot;
 }
+#endif
 
 /**
  * \ingroup sd_raw
@@ -608,6 +736,10 @@ uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interva
 
     return 1;
 #else
+#if SD_RAW_STREAMING
+    sd_raw_stream_stop();
+#endif
+
     /* address card */
     select_card();
 
@@ -720,74 +852,81 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
         /* Merge the data to write with the content of the block.
          * Use the cached block if available.
          */
-        if(block_address != raw_block_address)
-        {
+        uint8_t slot = sd_raw_cache_get(block_address, block_offset || write_length < 512);
+        if(slot == SD_RAW_CACHE_NONE)
+            return 0;
+
+        memcpy(raw_block[slot] + block_offset, buffer, write_length);
+
 #if SD_RAW_WRITE_BUFFERING
-            if(!sd_raw_sync())
-                return 0;
+        /* written back on eviction or by sd_raw_sync() */
+        raw_block_written[slot] = 0;
+#else
+        if(!sd_raw_write_block(block_address, raw_block[slot]))
+            return 0;
 #endif
 
-            if(block_offset || write_length < 512)
-            {
-                if(!sd_raw_read(block_address, raw_block, sizeof(raw_block)))
-                    return 0;
-            }
-            raw_block_address = block_address;
-        }
+        buffer += write_length;
+        offset += write_length;
+        length -= write_length;
+    }
 
-        if(buffer != raw_block)
-        {
-            memcpy(raw_block + block_offset, buffer, write_length);
+    return 1;
+}
 
-#if SD_RAW_WRITE_BUFFERING
-            raw_block_written = 0;
+/**
+ * \ingroup sd_raw
+ * Writes a single block to the card.
+ *
+ * \param[in] block_address The card address of the block.
+ * \param[in] buffer The 512 bytes to write.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t sd_raw_write_block(offset_t block_address, const uint8_t* buffer)
+{
+    if(sd_raw_locked())
+        return 0;
 
-            if(length == write_length)
-                return 1;
-#endif
-        }
+#if SD_RAW_STREAMING
+    /* address card, continue or start multiple block write */
+    if(!sd_raw_stream_open(CMD_WRITE_MULTIPLE_BLOCK, block_address))
+        return 0;
 
-        /* address card */
-        select_card();
+    /* send start byte of multiple block write */
+    sd_raw_send_byte(0xfc);
+#else
+    /* address card */
+    select_card();
 
-        /* send single block request */
+    /* send single block request */
 #if SD_RAW_SDHC
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+    if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
 #else
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, block_address))
+    if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, block_address))
 #endif
-        {
-            unselect_card();
-            return 0;
-        }
-
-        /* send start byte */
-        sd_raw_send_byte(0xfe);
-
-        /* write byte block */
-        uint8_t* cache = raw_block;
-        for(uint16_t i = 0; i < 512; ++i)
-            sd_raw_send_byte(*cache++);
+    {
+        unselect_card();
+        return 0;
+    }
 
-        /* write dummy crc16 */
-        sd_raw_send_byte(0xff);
-        sd_raw_send_byte(0xff);
+    /* send start byte */
+    sd_raw_send_byte(0xfe);
+#endif
 
-        /* wait while card is busy */
-        while(sd_raw_rec_byte() != 0xff);
-        sd_raw_rec_byte();
+    /* write byte block */
+    for(uint16_t i = 0; i < 512; ++i)
+        sd_raw_send_byte(*buffer++);
 
-        /* deaddress card */
-        unselect_card();
+    /* write dummy crc16 */
+    sd_raw_send_byte(0xff);
+    sd_raw_send_byte(0xff);
 
-        buffer += write_length;
-        offset += write_length;
-        length -= write_length;
+    /* wait while card is busy */
+    while(sd_raw_rec_byte() != 0xff);
+    sd_raw_rec_byte();
 
-#if SD_RAW_WRITE_BUFFERING
-        raw_block_written = 1;
-#endif
-    }
+    /* deaddress card */
+    unselect_card();
 
     return 1;
 }
@@ -860,11 +999,23 @@ uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length
 uint8_t sd_raw_sync(void)
 {
 #if SD_RAW_WRITE_BUFFERING
-    if(raw_block_written)
-        return 1;
-    if(!sd_raw_write(raw_block_address, raw_block, sizeof(raw_block)))
-        return 0;
-    raw_block_written = 1;
+    /* write back in ascending order, so that streaming can go on */
+    for(;;)
+    {
+        uint8_t slot = SD_RAW_CACHE_NONE;
+        for(uint8_t i = 0; i < SD_RAW_CACHE_BLOCKS; ++i)
+        {
+            if(!raw_block_written[i] &&
+               (slot == SD_RAW_CACHE_NONE || raw_block_address[i] < raw_block_address[slot]))
+                slot = i;
+        }
+        if(slot == SD_RAW_CACHE_NONE)
+            break;
+
+        if(!sd_raw_write_block(raw_block_address[slot], raw_block[slot]))
+            return 0;
+        raw_block_written[slot] = 1;
+    }
 #endif
     return 1;
 }
@@ -892,6 +1043,10 @@ uint8_t sd_raw_get_info(struct sd_raw_info* info)
 
     memset(info, 0, sizeof(*info));
 
+#if SD_RAW_STREAMING
+    sd_raw_stream_stop();
+#endif
+
     select_card();
 
     /* read cid register */
@@ -1033,3 +1188,101 @@ uint8_t sd_raw_get_info(struct sd_raw_info* info)
     return 1;
 }
 
+#if SD_RAW_STREAMING
+/**
+ * \ingroup sd_raw
+ * Addresses the card for reading or writing the block at \c block_address.
+ *
+ * Continues the open multiple block transfer if it is of the same kind
+ * and has arrived at this block, otherwise stops it and starts a new one.
+ *
+ * \param[in] command CMD_READ_MULTIPLE_BLOCK or CMD_WRITE_MULTIPLE_BLOCK.
+ * \param[in] block_address The card address of the block.
+ * \returns 0 on failure (the card is deaddressed), 1 on success.
+ */
+static uint8_t sd_raw_stream_open(uint8_t command, offset_t block_address)
+{
+    sd_raw_stream_used = 1;
+
+    if(sd_raw_stream_cmd != command || sd_raw_stream_next != block_address)
+    {
+        sd_raw_stream_stop();
+
+        /* address card */
+        select_card();
+
+        /* send multiple block request */
+#if SD_RAW_SDHC
+        if(sd_raw_send_command(command, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+#else
+        if(sd_raw_send_command(command, block_address))
+#endif
+        {
+            unselect_card();
+            return 0;
+        }
+
+        sd_raw_stream_cmd = command;
+    }
+    else
+    {
+        /* address card, the transfer continues where it stopped */
+        select_card();
+    }
+
+    sd_raw_stream_next = block_address + 512;
+    return 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Stops the open multiple block transfer, if any.
+ */
+static void sd_raw_stream_stop(void)
+{
+    if(!sd_raw_stream_cmd)
+        return;
+
+    /* address card */
+    select_card();
+
+    if(sd_raw_stream_cmd == CMD_READ_MULTIPLE_BLOCK)
+        sd_raw_send_command(CMD_STOP_TRANSMISSION, 0);
+    else
+    {
+        /* send stop tran token */
+        sd_raw_send_byte(0xfd);
+        sd_raw_rec_byte();
+    }
+
+    /* wait while card is busy */
+    while(sd_raw_rec_byte() != 0xff);
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+
+    sd_raw_stream_cmd = 0;
+}
+
+/**
+ * \ingroup sd_raw
+ * Stops the open multiple block transfer, if it has not been used since
+ * the last call.
+ */
+void sd_raw_stream_periodic(void)
+{
+    if(sd_raw_stream_used)
+        sd_raw_stream_used = 0;
+    else
+        sd_raw_stream_stop();
+}
+#endif
+
+/*
+  -- Ethersex META --
+  header(hardware/storage/sd_reader/sd_raw.h)
+  ifdef(`conf_SD_STREAM_SUPPORT', `timer(5, `sd_raw_stream_periodic()')')
+*/
@@ -136,6 +136,15 @@ uint8_t sd_raw_sync(void);
 
 uint8_t sd_raw_get_info(struct sd_raw_info* info);
 
+#if SD_RAW_STREAMING
+void sd_raw_stream_periodic(void);
+#endif
+
+#ifdef SD_CACHE_SUPPORT
+extern uint32_t sd_raw_cache_hits;
+extern uint32_t sd_raw_cache_misses;
+#endif
+
 /* init.c */
 extern struct partition_struct *sd_active_partition;
 uint8_t sd_try_init (void);
@@ -68,6 +68,32 @@ extern "C"
  */
 #define SD_RAW_SDHC SD_SDHC_SUPPORT
 
+/**
+ * \ingroup sd_raw_config
+ * Controls streaming of consecutive blocks.
+ *
+ * Set to 1 to keep a multiple block transfer (CMD18/CMD25) open
+ * while consecutive blocks are read or written.  The transfer is
+ * stopped on any other access or when the card has been idle for
+ * a timer tick.
+ */
+#define SD_RAW_STREAMING SD_STREAM_SUPPORT
+
+/**
+ * \ingroup sd_raw_config
+ * Controls the number of blocks buffered in RAM.
+ *
+ * Each block takes 512 bytes of RAM.  With more than one block,
+ * the least recently used one is replaced on a miss.
+ *
+ * \note This option has no effect when SD_RAW_SAVE_RAM is 1.
+ */
+#ifdef SD_CACHE_SUPPORT
+#define SD_RAW_CACHE_BLOCKS SD_CACHE_BLOCKS
+#else
+#define SD_RAW_CACHE_BLOCKS 1
+#endif
+
 /**
  * @}
  */
@@ -110,6 +136,13 @@ extern "C"
 #undef SD_RAW_WRITE_BUFFERING
 #define SD_RAW_WRITE_BUFFERING 0
 #endif
+#if SD_RAW_CACHE_BLOCKS > 1
+#undef SD_RAW_SAVE_RAM
+#define SD_RAW_SAVE_RAM 0
+#endif
+#if SD_RAW_CACHE_BLOCKS < 1 || SD_RAW_CACHE_BLOCKS > 32
+#error "SD_CACHE_BLOCKS must be between 1 and 32"
+#endif
 
 
 #ifdef DEBUG_SD_READER_FAT
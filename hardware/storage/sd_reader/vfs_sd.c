@@ -308,6 +308,18 @@ vfs_sd_size(struct vfs_file_handle_t * fh)
   return fh->u.sd->dir_entry.file_size;
 }
 
+uint32_t
+vfs_sd_etag(struct vfs_file_handle_t * fh)
+{
+#if FAT_DATETIME_SUPPORT
+  struct fat_dir_entry_struct *de = &fh->u.sd->dir_entry;
+  return ((uint32_t) de->modification_date << 16 | de->modification_time)
+    ^ de->file_size ^ de->cluster;
+#else
+  return 0;                     /* Writes don't leave a trace. */
+#endif
+}
+
 #ifdef SD_PING_READ
 static uint8_t
 vfs_sd_ping(void)
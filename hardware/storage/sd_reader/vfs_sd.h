@@ -42,6 +42,7 @@ uint8_t vfs_sd_truncate(struct vfs_file_handle_t *, vfs_size_t length);
 struct vfs_file_handle_t *vfs_sd_create(const char *name);
 uint8_t vfs_sd_unlink(const char *name);
 vfs_size_t vfs_sd_size(struct vfs_file_handle_t *);
+uint32_t vfs_sd_etag(struct vfs_file_handle_t *);
 uint8_t vfs_sd_mkdir_recursive(const char *path);
 
 
@@ -57,6 +58,8 @@ uint8_t vfs_sd_mkdir_recursive(const char *path);
     vfs_sd_create,				\
     vfs_sd_unlink,				\
     vfs_sd_size,				\
+    NULL, /* pread */				\
+    vfs_sd_etag,				\
   }
 #else
 #define VFS_SD_FUNCS {				\
@@ -70,6 +73,8 @@ uint8_t vfs_sd_mkdir_recursive(const char *path);
     NULL, /* create */				\
     NULL, /* unlink */				\
     vfs_sd_size,				\
+    NULL, /* pread */				\
+    vfs_sd_etag,				\
   }
 #endif
 
@@ -72,9 +72,27 @@ int16_t parse_cmd_nslookup (char *cmd, char *output, uint16_t len)
   }
 }
 
+int16_t parse_cmd_dns_stats (char *cmd, char *output, uint16_t len)
+{
+  while (*cmd == ' ') cmd ++;
+
+  if (strcmp_P (cmd, PSTR ("reset")) == 0) {
+    memset (&resolv_stats, 0, sizeof (resolv_stats));
+    return ECMD_FINAL_OK;
+  }
+  if (*cmd)
+    return ECMD_ERR_PARSE_ERROR;
+
+  return ECMD_FINAL(snprintf_P(output, len,
+                               PSTR("hits %u negative %u joined %u misses %u"),
+                               resolv_stats.hits, resolv_stats.negative_hits,
+                               resolv_stats.joined, resolv_stats.misses));
+}
+
 /*
   -- Ethersex META --
   block(DNS Resolver)
   ecmd_feature(nslookup, "nslookup ", HOSTNAME, Do DNS lookup for HOSTNAME (call twice).)
   ecmd_feature(dns_server, "dns server", [IPADDR], Display/Set the IP address of the DNS server to use to IPADDR.)
+  ecmd_feature(dns_stats, "dns stats", [reset], Print or reset the DNS cache hit and miss counters.)
 */
@@ -112,6 +112,9 @@ struct dns_answer {
   uip_ipaddr_t ipaddr;
 };
 
+/** \internal A cached name.  Answers (STATE_DONE) and failed lookups
+    (STATE_ERROR) are kept for ttl seconds, callbacks are called once
+    the answer is there. */
 struct namemap {
 #define STATE_UNUSED 0
 #define STATE_NEW    1
@@ -123,13 +126,14 @@ struct namemap {
   u8_t retries;
   u8_t seqno;
   u8_t err;
+  u16_t ttl;
   char name[32];
   uip_ipaddr_t ipaddr;
-  resolv_found_callback_t callback;
+  resolv_found_callback_t callback[DNS_CALLBACKS];
 };
 
 #ifndef UIP_CONF_RESOLV_ENTRIES
-#define RESOLV_ENTRIES 4
+#define RESOLV_ENTRIES DNS_CACHE_ENTRIES
 #else /* UIP_CONF_RESOLV_ENTRIES */
 #define RESOLV_ENTRIES UIP_CONF_RESOLV_ENTRIES
 #endif /* UIP_CONF_RESOLV_ENTRIES */
@@ -151,8 +155,13 @@ static struct namemap names[RESOLV_ENTRIES];
 
 static u8_t seqno;
 
+struct resolv_stats resolv_stats;
+
 static uip_udp_conn_t *resolv_conn = NULL;
 
+/* Set while the callbacks of a question pushed out are called. */
+static u8_t resolv_evicting;
+
 
 /*---------------------------------------------------------------------------*/
 /** \internal
@@ -184,6 +193,61 @@ parse_name(unsigned char *query)
   return query + 1;
 }
 /*---------------------------------------------------------------------------*/
+/** \internal
+ * Remember a callback of an entry, unless it is known already.
+ *
+ * \return Zero if there is no room left for the callback.
+ */
+/*---------------------------------------------------------------------------*/
+static u8_t
+add_callback(struct namemap *namemapptr, resolv_found_callback_t callback)
+{
+  if(callback == NULL)
+    return 1;
+
+  for(u8_t i = 0; i < DNS_CALLBACKS; ++i) {
+    if(namemapptr->callback[i] == NULL ||
+       namemapptr->callback[i] == callback) {
+      namemapptr->callback[i] = callback;
+      return 1;
+    }
+  }
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * Tell all callbacks of an entry about the result of the lookup.  The
+ * callbacks are forgotten before, so they may query again.
+ */
+/*---------------------------------------------------------------------------*/
+static void
+notify(struct namemap *namemapptr)
+{
+  resolv_found_callback_t callback[DNS_CALLBACKS];
+  uip_ipaddr_t *ipaddr = NULL;
+
+  memcpy(callback, namemapptr->callback, sizeof(callback));
+  memset(namemapptr->callback, 0, sizeof(callback));
+
+  if(namemapptr->state == STATE_DONE)
+    ipaddr = (uip_ipaddr_t *)namemapptr->ipaddr;
+
+  for(u8_t i = 0; i < DNS_CALLBACKS && callback[i]; ++i)
+    callback[i](namemapptr->name, ipaddr);
+}
+/*---------------------------------------------------------------------------*/
+/** \internal
+ * The lookup failed, remember this for a while.
+ */
+/*---------------------------------------------------------------------------*/
+static void
+failed(struct namemap *namemapptr)
+{
+  namemapptr->state = STATE_ERROR;
+  namemapptr->ttl = DNS_CACHE_NEGTTL;
+  notify(namemapptr);
+}
+/*---------------------------------------------------------------------------*/
 /** \internal
  * Runs through the list of names to see if there are any that have
  * not yet been queried and, if so, sends out a query.
@@ -196,6 +260,14 @@ resolv_periodic(void)
   char *query, *nptr, *nameptr;
   register struct namemap *namemapptr;
 
+  for(u8_t i = 0; i < RESOLV_ENTRIES; ++i) {
+    namemapptr = &names[i];
+
+    /* Answered from the cache. */
+    if(namemapptr->state >= STATE_DONE && namemapptr->callback[0])
+      notify(namemapptr);
+  }
+
   for(u8_t i = 0; i < RESOLV_ENTRIES; ++i) {
     namemapptr = &names[i];
     if(namemapptr->state == STATE_NEW ||
@@ -203,9 +275,7 @@ resolv_periodic(void)
       if(namemapptr->state == STATE_ASKING) {
 	if(--namemapptr->tmr == 0) {
 	  if(++namemapptr->retries == MAX_RETRIES) {
-	    namemapptr->state = STATE_ERROR;
-            if (namemapptr->callback)
-              namemapptr->callback(namemapptr->name, NULL);
+	    failed(namemapptr);
 	    continue;
 	  }
 	  namemapptr->tmr = namemapptr->retries;
@@ -219,6 +289,7 @@ resolv_periodic(void)
 	namemapptr->state = STATE_ASKING;
 	namemapptr->tmr = 1;
 	namemapptr->retries = 0;
+	resolv_stats.misses++;
       }
       hdr = (struct dns_hdr *)uip_appdata;
       memset(hdr, 0, sizeof(struct dns_hdr));
@@ -291,9 +362,7 @@ resolv_newdata(void)
 
     /* Check for error. If so, call callback to inform. */
     if(namemapptr->err != 0 || hdr->numanswers == 0) {
-      namemapptr->state = STATE_ERROR;
-      if (namemapptr->callback)
-        namemapptr->callback(namemapptr->name, NULL);
+      failed(namemapptr);
       return;
     }
 
@@ -345,14 +414,21 @@ resolv_newdata(void)
 	namemapptr->ipaddr[1] = ans->ipaddr[1];
 #endif /* !UIP_CONF_IPV6 */
 
-        if (namemapptr->callback)
-          namemapptr->callback(namemapptr->name, (uip_ipaddr_t *)namemapptr->ipaddr);
+	/* Keep the address as long as the answer says. */
+	uint32_t ttl = ((uint32_t)htons(ans->ttl[0]) << 16) |
+	  htons(ans->ttl[1]);
+	namemapptr->ttl = ttl > DNS_CACHE_MAXTTL ? DNS_CACHE_MAXTTL : ttl;
+
+	notify(namemapptr);
 	return;
       } else {
 	nameptr = nameptr + 10 + htons(ans->len);
       }
       --nanswers;
     }
+
+    /* No address among the answers, e.g. only a CNAME. */
+    failed(namemapptr);
   }
 
 }
@@ -361,24 +437,58 @@ resolv_newdata(void)
 /**
  * Queues a name so that a question for the name will be sent out.
  *
+ * The callback is called with the cached result, if there is one, and
+ * joins the question if the name is being asked for already.  It is
+ * never called from within resolv_query() itself.  If every entry is
+ * busy, the question of the least recently used one fails and its
+ * callbacks are called with NULL from here.
+ *
  * \param name The hostname that is to be queried.
+ *
+ * \return Zero if the callback could not be remembered, e.g. because
+ * the name already has DNS_CALLBACKS of them, non-zero otherwise.
  */
 /*---------------------------------------------------------------------------*/
-void
+u8_t
 resolv_query(const char *name, resolv_found_callback_t callback)
 {
   u8_t i;
-  u8_t lseq, lseqi;
+  u8_t lseq, lseqi, busy;
   register struct namemap *nameptr = NULL;
 
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    nameptr = &names[i];
+    if(nameptr->state != STATE_UNUSED &&
+       strcmp(name, nameptr->name) == 0) {
+      /* A second entry for the name would ask the same question. */
+      if(!add_callback(nameptr, callback))
+	return 0;
+
+      if(nameptr->state == STATE_DONE)
+	resolv_stats.hits++;
+      else if(nameptr->state == STATE_ERROR)
+	resolv_stats.negative_hits++;
+      else
+	resolv_stats.joined++;
+      nameptr->seqno = seqno++;
+      return 1;
+    }
+  }
+
+  /* Take a free entry, else the least recently used one.  Questions
+     not answered yet and answers not delivered yet are taken last. */
   lseq = lseqi = 0;
+  busy = 1;
 
   for(i = 0; i < RESOLV_ENTRIES; ++i) {
     nameptr = &names[i];
     if(nameptr->state == STATE_UNUSED) {
       break;
     }
-    if(seqno - nameptr->seqno > lseq) {
+    u8_t nbusy = nameptr->state < STATE_DONE || nameptr->callback[0];
+    if(nbusy < busy ||
+       (nbusy == busy && (u8_t)(seqno - nameptr->seqno) >= lseq)) {
+      busy = nbusy;
       lseq = seqno - nameptr->seqno;
       lseqi = i;
     }
@@ -387,6 +497,20 @@ resolv_query(const char *name, resolv_found_callback_t callback)
   if(i == RESOLV_ENTRIES) {
     i = lseqi;
     nameptr = &names[i];
+
+    /* All entries are busy, the question of this one fails.  Its
+       callbacks may query again, but not push out further questions. */
+    if(busy) {
+      if(resolv_evicting)
+	return 0;
+      resolv_evicting = 1;
+      failed(nameptr);
+      resolv_evicting = 0;
+
+      /* Asked for again by one of the callbacks. */
+      if(nameptr->callback[0])
+	return 0;
+    }
   }
 
   /*  printf("Using entry %d\n", i);*/
@@ -394,8 +518,10 @@ resolv_query(const char *name, resolv_found_callback_t callback)
   strcpy(nameptr->name, name);
   nameptr->state = STATE_NEW;
   nameptr->seqno = seqno;
-  nameptr->callback = callback;
+  memset(nameptr->callback, 0, sizeof(nameptr->callback));
+  add_callback(nameptr, callback);
   ++seqno;
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -422,6 +548,8 @@ resolv_lookup(const char *name)
     nameptr = &names[i];
     if(nameptr->state == STATE_DONE &&
        strcmp(name, nameptr->name) == 0) {
+      resolv_stats.hits++;
+      nameptr->seqno = seqno++;
       return (uip_ipaddr_t *)nameptr->ipaddr;
     }
   }
@@ -459,6 +587,12 @@ resolv_conf(uip_ipaddr_t *dnsserver)
     uip_udp_remove(resolv_conn);
   }
 
+  /* Failed lookups may have been the old server's fault. */
+  for(u8_t i = 0; i < RESOLV_ENTRIES; ++i) {
+    if(names[i].state == STATE_ERROR && !names[i].callback[0])
+      names[i].state = STATE_UNUSED;
+  }
+
   resolv_conn = uip_udp_new(dnsserver, HTONS(53), dns_net_main);
 }
 /*---------------------------------------------------------------------------*/
@@ -475,10 +609,29 @@ resolv_init(void)
   resolv_conf(&dnsserver);
 
   for(u8_t i = 0; i < RESOLV_ENTRIES; ++i) {
-    names[i].state = STATE_DONE;
+    names[i].state = STATE_UNUSED;
   }
 
 }
+/*---------------------------------------------------------------------------*/
+/**
+ * Age the cached names, called once a second.
+ */
+/*---------------------------------------------------------------------------*/
+void
+resolv_timer(void)
+{
+  register struct namemap *nameptr;
+
+  for(u8_t i = 0; i < RESOLV_ENTRIES; ++i) {
+    nameptr = &names[i];
+    /* Keep answers until they are delivered. */
+    if(nameptr->state >= STATE_DONE && !nameptr->callback[0] &&
+       (nameptr->ttl == 0 || --nameptr->ttl == 0)) {
+      nameptr->state = STATE_UNUSED;
+    }
+  }
+}
 
 
 /*---------------------------------------------------------------------------*/
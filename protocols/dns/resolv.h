@@ -59,15 +59,26 @@
  */
 typedef void (*resolv_found_callback_t)(char *name, uip_ipaddr_t *ip);
 
+/** Cache statistics, see the "dns stats" command. */
+struct resolv_stats {
+  u16_t hits;			/* answered from the cache */
+  u16_t negative_hits;		/* failed lookup answered from the cache */
+  u16_t joined;			/* joined a question already asked */
+  u16_t misses;			/* questions sent */
+};
+
+extern struct resolv_stats resolv_stats;
+
 /* Functions. */
 void resolv_periodic(void);
 void resolv_newdata(void);
+void resolv_timer(void);
 
 void resolv_conf(uip_ipaddr_t *dnsserver);
 uip_ipaddr_t *resolv_getserver(void);
 void resolv_init(void);
 uip_ipaddr_t *resolv_lookup(const char *name);
-void resolv_query(const char *name, resolv_found_callback_t callback);
+u8_t resolv_query(const char *name, resolv_found_callback_t callback);
 
 #endif /* __RESOLV_H__ */
 
@@ -1,10 +1,21 @@
 dnl This m4 script uses quite a few divert levels, these are essentially:
 dnl   1: function prototypes
 dnl   2: char array in program space
-dnl   3: the function list
 dnl   4: function list trailer
 dnl   5: (optional) function implementations 
 dnl
+dnl The function list itself is grouped into hash buckets over the first two
+dnl characters of the command names, which needs two divert levels per bucket
+dnl (positions and table entries), starting at ecmd_divert_base:
+dnl   base + 0:             enum header
+dnl   base + 1 + 2b:        positions of the commands in bucket b
+dnl   base + 2 + 2b:        end of bucket b
+dnl   base + 1 + 2n:        bucket table, function list header
+dnl   base + 2 + 2n + b:    function list entries of bucket b
+dnl   base + 2 + 3n:        function list trailer
+dnl Since the commands are spread across many divert levels, conditionals
+dnl are kept on a stack and written out as `#if' around each entry.
+dnl
 dnl ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 dnl
 dnl   Copyright (c) 2007 by Christian Dietrich <stettberger@dokucode.de>
@@ -43,42 +54,112 @@ divert(1)dnl
 divert(2)dnl
 
 /* Char array definitions follow */
-divert(3)dnl
-
-/* Definition of function pointer array follows */
-const struct ecmd_command_t PROGMEM ecmd_cmds[] = {
 divert(-1)dnl
 
+dnl Has to match ECMD_HASH_BUCKETS and ECMD_HASH() in parser.h
+define(`ecmd_nbuckets', 64)
+define(`ecmd_divert_base', 2000)
+
+dnl ASCII code of a character, `#', `$' and the quotes are not allowed
+define(`ecmd_ascii_table', `` !"  %& ()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\]^_ abcdefghijklmnopqrstuvwxyz{|}~'')
+define(`ecmd_ascii', `ifelse(index(ecmd_ascii_table, `$1'), -1,
+  `errprint(`ecmd: unsupported character in command name: $1
+')m4exit(1)', `eval(32 + index(ecmd_ascii_table, `$1'))')')
+
+dnl ecmd_hash("name") -- bucket of a quoted command name, the name may
+dnl still carry m4 quotes around the C string, e.g. ``"irc init"''
+define(`ecmd_hash', `_ecmd_hash(`$1', index(`$1', `"'))')
+define(`_ecmd_hash', `ifelse($2, -1, `errprint(`ecmd: command name not quoted: $1
+')m4exit(1)', substr(`$1', eval($2 + 2), 1), `"',
+  `errprint(`ecmd: command name too short: $1
+')m4exit(1)', `eval((ecmd_ascii(substr(`$1', eval($2 + 1), 1)) * 7
+  + ecmd_ascii(substr(`$1', eval($2 + 2), 1))) & (ecmd_nbuckets - 1))')')
+
+dnl Number of commands, ecmd_bucket_start[] has to be able to index them all
+define(`ecmd_count', 0)
+define(`ecmd_count_max', 65535)
+define(`ecmd_count_incr', `define(`ecmd_count', incr(ecmd_count))dnl
+ifelse(eval(ecmd_count > ecmd_count_max), 1,
+  `errprint(`ecmd: more than 'ecmd_count_max` commands
+')m4exit(1)')')
+
+dnl stack of conditionals, as a C expression
+define(`ecmd_guard', `')
+define(`ecmd_guard_push', `pushdef(`ecmd_guard_outer', ecmd_guard)dnl
+pushdef(`ecmd_guard_term', `$1')dnl
+pushdef(`ecmd_guard', ifelse(ecmd_guard, `', `$1', ecmd_guard` && $1'))')
+define(`ecmd_guard_else', `define(`ecmd_guard_term', `!('ecmd_guard_term`)')dnl
+define(`ecmd_guard', ifelse(ecmd_guard_outer, `', ecmd_guard_term,
+  ecmd_guard_outer` && 'ecmd_guard_term))')
+define(`ecmd_guard_pop', `popdef(`ecmd_guard')popdef(`ecmd_guard_term')dnl
+popdef(`ecmd_guard_outer')')
+define(`ecmd_guarded', `ifelse(ecmd_guard, `', `$1',
+  `_ecmd_guarded(ecmd_guard, `$1')')')
+define(`_ecmd_guarded', `#if $1
+$2#endif
+')
+
 define(`ecmd_feature', `dnl
+ecmd_count_incr()dnl
 divert(1)int16_t parse_cmd_$1 (char *cmd, char *output, uint16_t len);
 divert(2)const char PROGMEM ecmd_$1_text[] = $2;
-divert(3)	{ ecmd_$1_text, parse_cmd_$1 },
+define(`ecmd_b', ecmd_hash(`$2'))dnl
+divert(eval(ecmd_divert_base + 1 + 2 * ecmd_b))ecmd_guarded(`	ecmd_pos_$1,
+')dnl
+divert(eval(ecmd_divert_base + 2 + 2 * ecmd_nbuckets + ecmd_b))dnl
+ecmd_guarded(`	{ ecmd_$1_text, parse_cmd_$1 },
+')dnl
 divert(-1)')
 
 define(`ecmd_ifdef', `dnl
 divert(1)#ifdef $1
 divert(2)#ifdef $1
-divert(3)#ifdef $1
-divert(-1)')
+divert(-1)ecmd_guard_push(`defined($1)')')
 
 define(`ecmd_ifndef', `dnl
 divert(1)#ifndef $1
 divert(2)#ifndef $1
-divert(3)#ifndef $1
-divert(-1)')
+divert(-1)ecmd_guard_push(`!defined($1)')')
 
 define(`ecmd_else', `dnl
 divert(1)#else
 divert(2)#else
-divert(3)#else
-divert(-1)')
+divert(-1)ecmd_guard_else()')
 
 define(`ecmd_endif', `divert(1)#endif
 divert(2)#endif
-divert(3)#endif
+divert(-1)ecmd_guard_pop()')
+
+dnl forloop(var, from, to, stmt)
+define(`ecmd_forloop', `pushdef(`$1', `$2')_ecmd_forloop($@)popdef(`$1')')
+define(`_ecmd_forloop',
+  `$4`'ifelse($1, `$3', `', `define(`$1', incr($1))$0($@)')')
+
+divert(ecmd_divert_base)dnl
+
+/* Position of each command in ecmd_cmds[], grouped by hash bucket */
+enum {
+divert(-1)
+ecmd_forloop(`ecmd_i', 0, decr(ecmd_nbuckets), `dnl
+divert(eval(ecmd_divert_base + 2 + 2 * ecmd_i))dnl
+	ECMD_BUCKET_END_`'ecmd_i,
+	ECMD_BUCKET_MARK_`'ecmd_i = ECMD_BUCKET_END_`'ecmd_i - 1,
 divert(-1)')
 
-divert(4)dnl
+divert(eval(ecmd_divert_base + 1 + 2 * ecmd_nbuckets))dnl
+};
+
+/* Bucket b holds ecmd_cmds[ecmd_bucket_start[b]] up to (but excluding)
+   ecmd_cmds[ecmd_bucket_start[b + 1]] */
+const uint16_t PROGMEM ecmd_bucket_start[ECMD_HASH_BUCKETS + 1] = {
+	0,
+ecmd_forloop(`ecmd_i', 0, decr(ecmd_nbuckets), `	ECMD_BUCKET_END_`'ecmd_i,
+')dnl
+};
+
+/* Definition of function pointer array follows */
+const struct ecmd_command_t PROGMEM ecmd_cmds[] = {
+divert(eval(ecmd_divert_base + 2 + 3 * ecmd_nbuckets))dnl
         { NULL, NULL }
 };
 divert(-1)dnl
@@ -110,37 +110,34 @@ ecmd_parse_command(char *cmd, char *output, uint16_t len)
 
   char *text = NULL;
   int16_t(*func) (char *, char *, uint16_t) = NULL;
-  uint8_t pos = 0;
 
-  while (1)
+  /* Only the commands sharing the hash of our first two characters can
+   * match, every command name has at least two. */
+  uint8_t bucket = ECMD_HASH(cmd[0], cmd[1]);
+  uint16_t pos = pgm_read_word(&ecmd_bucket_start[bucket]);
+  uint16_t end = pgm_read_word(&ecmd_bucket_start[bucket + 1]);
+
+  for (; pos < end; pos++)
   {
     /* load pointer to text */
     text = (char *) pgm_read_word(&ecmd_cmds[pos].name);
 
 #ifdef DEBUG_ECMD
     debug_printf("loaded text addres %p: \n", text);
-#endif
-
-    /* return if we reached the end of the array */
-    if (text == NULL)
-      break;
-
-#ifdef DEBUG_ECMD
     debug_printf("text is: \"%S\"\n", text);
 #endif
 
-    /* else compare texts */
-    if (memcmp_P(cmd, text, strlen_P(text)) == 0)
+    /* compare texts */
+    size_t text_len = strlen_P(text);
+    if (memcmp_P(cmd, text, text_len) == 0)
     {
 #ifdef DEBUG_ECMD
       debug_printf("found match\n");
 #endif
-      cmd += strlen_P(text);
+      cmd += text_len;
       func = (void *) pgm_read_word(&ecmd_cmds[pos].func);
       break;
     }
-
-    pos++;
   }
 
 #ifdef DEBUG_ECMD
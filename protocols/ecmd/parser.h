@@ -39,4 +39,13 @@ struct ecmd_command_t {
 /* automatically generated via meta system */
 extern const struct ecmd_command_t ecmd_cmds[];
 
+/* ecmd_cmds[] is grouped by a hash over the first two characters of the
+ * command names, ecmd_bucket_start[] tells where each bucket begins.
+ * Has to match ecmd_hash in ecmd_magic.m4. */
+#define ECMD_HASH_BUCKETS 64
+#define ECMD_HASH(c0, c1) \
+  (((uint8_t) (c0) * 7 + (uint8_t) (c1)) & (ECMD_HASH_BUCKETS - 1))
+
+extern const uint16_t ecmd_bucket_start[];
+
 #endif /* _ECMD_PARSER_H */
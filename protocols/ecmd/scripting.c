@@ -72,6 +72,40 @@ typedef struct
 
 script_t current_script;
 
+#ifdef ECMD_SCRIPT_LINECACHE_SUPPORT
+#if ECMD_SCRIPT_READAHEAD < ECMD_INPUTBUF_LENGTH
+#error ECMD_SCRIPT_READAHEAD has to hold at least one input line
+#endif
+
+/* block of the script read ahead, so that sequential lines don't each
+ * cost a seek and a read */
+static struct
+{
+  vfs_size_t start;
+  uint16_t fill;
+  char data[ECMD_SCRIPT_READAHEAD];
+} readahead;
+
+/* file offset of each line number seen so far (up to lines_known),
+ * so that goto can seek instead of reading from the start */
+static uint16_t line_offset[ECMD_SCRIPT_MAXLINES];
+static uint16_t lines_known;
+#endif
+
+/* start reading from the beginning of a freshly opened script */
+static void
+script_rewind(void)
+{
+  current_script.linenumber = 0;
+  current_script.filepointer = 0;
+#ifdef ECMD_SCRIPT_LINECACHE_SUPPORT
+  readahead.start = (vfs_size_t) -1;
+  readahead.fill = 0;
+  line_offset[0] = 0;
+  lines_known = 0;
+#endif
+}
+
 static int16_t
 to_many_vars_error_message(char *output, uint16_t len)
 {
@@ -85,11 +119,36 @@ to_many_vars_error_message(char *output, uint16_t len)
 static vfs_size_t
 vfs_fgets(struct vfs_file_handle_t *handle, char *line, vfs_size_t pos)
 {
+#ifdef ECMD_SCRIPT_LINECACHE_SUPPORT
+  vfs_size_t off = pos - readahead.start;
+  /* refill, unless a whole input line is buffered or the buffer already
+   * reaches up to the end of the file */
+  if (pos < readahead.start || off > readahead.fill ||
+      (off + ECMD_INPUTBUF_LENGTH - 1 > readahead.fill &&
+       readahead.fill == ECMD_SCRIPT_READAHEAD))
+  {
+    vfs_fseek(handle, pos, SEEK_SET);
+    vfs_size_t fill = vfs_read(handle, readahead.data, ECMD_SCRIPT_READAHEAD);
+    readahead.start = pos;
+    readahead.fill = fill > ECMD_SCRIPT_READAHEAD ? 0 : fill;
+    off = 0;
+  }
+  vfs_size_t readlen = readahead.fill - off;
+  if (readlen > ECMD_INPUTBUF_LENGTH - 1)
+    readlen = ECMD_INPUTBUF_LENGTH - 1;
+  memcpy(line, readahead.data + off, readlen);
+#else
   vfs_fseek(handle, pos, SEEK_SET);
   vfs_size_t readlen = vfs_read(handle, line, ECMD_INPUTBUF_LENGTH - 1);
+#endif
 
   line[ECMD_INPUTBUF_LENGTH - 1] = 0;
   SCRIPTDEBUG("fgets (%i) : %s\n", readlen, line);
+  if (readlen == 0 || readlen == (vfs_size_t) -1)
+  {
+    line[0] = 0;
+    return -1;                  // end of file
+  }
   vfs_size_t i = 0;
   while (i < readlen && line[i] != 0x0a)
   {
@@ -106,12 +165,21 @@ readline(char *buf)
   vfs_size_t len =
     vfs_fgets(current_script.handle, buf, current_script.filepointer);
   SCRIPTDEBUG("readline: %s\n", buf);
-  if (len == -1 || len >= ECMD_INPUTBUF_LENGTH)
+  if (len == (vfs_size_t) -1 || len >= ECMD_INPUTBUF_LENGTH)
   {
     return 0;
   }
   current_script.filepointer += len + 1;
   current_script.linenumber++;
+#ifdef ECMD_SCRIPT_LINECACHE_SUPPORT
+  if (current_script.linenumber == lines_known + 1 &&
+      current_script.linenumber < ECMD_SCRIPT_MAXLINES &&
+      current_script.filepointer <= UINT16_MAX)
+  {
+    line_offset[current_script.linenumber] = current_script.filepointer;
+    lines_known++;
+  }
+#endif
   return (uint8_t) len;
 }
 
@@ -130,6 +198,17 @@ parse_cmd_goto(char *cmd, char *output, uint16_t len)
   SCRIPTDEBUG("current %u goto line %u\n", current_script.linenumber,
               gotoline);
 
+#ifdef ECMD_SCRIPT_LINECACHE_SUPPORT
+  /* jump as close to the target as we know the way, read on from there */
+  uint16_t known = gotoline < lines_known ? gotoline : lines_known;
+  if (gotoline < current_script.linenumber ||
+      known > current_script.linenumber)
+  {
+    SCRIPTDEBUG("seek to line %u\n", known);
+    current_script.linenumber = known;
+    current_script.filepointer = line_offset[known];
+  }
+#else
   if (gotoline < current_script.linenumber)
   {
     SCRIPTDEBUG("seek to 0\n");
@@ -137,12 +216,16 @@ parse_cmd_goto(char *cmd, char *output, uint16_t len)
     current_script.linenumber = 0;
     current_script.filepointer = 0;
   }
+#endif
   while ((current_script.linenumber != gotoline) &&
          (current_script.linenumber < ECMD_SCRIPT_MAXLINES))
   {
     SCRIPTDEBUG("seeking: current %i goto line %i\n",
                 current_script.linenumber, gotoline);
-    if (readline(line) == 0)
+    /* empty lines are fine, only stop at the end of the script */
+    uint16_t linenumber = current_script.linenumber;
+    readline(line);
+    if (current_script.linenumber == linenumber)
     {
       SCRIPTDEBUG("leaving\n");
       break;
@@ -186,8 +269,7 @@ parse_cmd_call(char *cmd, char *output, uint16_t len)
   filesize = vfs_size(current_script.handle);
 
   SCRIPTDEBUG("start %s from %i bytes\n", filename, filesize);
-  current_script.linenumber = 0;
-  current_script.filepointer = 0;
+  script_rewind();
 
   // open file as long it is open, we have not reached max lines and 
   // not the end of the file as we know it
@@ -233,8 +315,7 @@ parse_cmd_cat(char *cmd, char *output, uint16_t len)
   filesize = vfs_size(current_script.handle);
 
   SCRIPTDEBUG("cat %s from %i bytes\n", filename, filesize);
-  current_script.linenumber = 0;
-  current_script.filepointer = 0;
+  script_rewind();
 
   // open file as long it is open, we have not reached max lines and 
   // not the end of the file as we know it
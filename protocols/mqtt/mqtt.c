@@ -43,6 +43,8 @@
  *    (if supplied)
  *  - the close_callback will be fired on a connection close/abort
  *    (if supplied)
+ *  - with MQTT_OUTBOX_SUPPORT, mqtt_queue_publish_packet(.) publishes with
+ *    QoS 1 at any time, see the outbox below
  *
  * Make sure to only write packets when the connection is established
  * (mqtt_is_connected() returns true), which is guaranteed during the
@@ -76,7 +78,24 @@
  *
  *  - Only one simultaneous connection
  *  - Only one topic per subscription message
- *  - QoS level 0 only (for publish and subscription messages)
+ *  - QoS level 0 only for subscriptions, QoS 1 publishing needs the outbox
+ *
+ * The outbox:
+ *
+ * QoS 1 publish packets are kept in the mqtt_outbox until the broker
+ * acknowledges them.  Each record is the length of the packet (2 bytes), its
+ * message id (2 bytes, 0 once acknowledged out of order) and the packet
+ * itself, oldest first.  mqtt_outbox_sent is the index behind the records
+ * already put into the send queue on this connection.  After a reconnect
+ * all records are sent again, with the DUP flag set.
+ *
+ * If the outbox is full, new records are appended to a VFS file
+ * (MQTT_OUTBOX_VFS_SUPPORT) and moved back into the outbox as soon as there is
+ * room again.  Their message id is assigned then.
+ *
+ * With UIP_TCP_WINDOW_SUPPORT the connection is windowed, uip keeps the
+ * segments in flight and the send queue drains as fast as the TCP window
+ * allows.
  *
  *  Note:
  *
@@ -101,6 +120,10 @@
 #include "mqtt_state.h"
 #include "core/debug.h"
 
+#ifdef MQTT_OUTBOX_VFS_SUPPORT
+#include "core/vfs/vfs.h"
+#endif
+
 // DEBUG MACROS
 
 #ifdef MQTT_DEBUG
@@ -144,6 +167,33 @@ static mqtt_connection_state_t mqtt_con_state;
 static uip_conn_t *mqtt_uip_conn;
 
 static uint16_t mqtt_timer_counter = 0;
+static uint16_t mqtt_last_poll;
+
+// OUTBOX
+
+#ifdef MQTT_OUTBOX_SUPPORT
+#define MQTT_DUP_FLAG           (1 << 3)
+#define MQTT_OUTBOX_HEADER      4       // record length and message id
+
+// the outbox has to take any packet the send queue takes
+#if MQTT_OUTBOX_LENGTH < MQTT_OUTBOX_HEADER + MQTT_SENDBUFFER_LENGTH - 1
+#error "MQTT_OUTBOX_LENGTH must be at least MQTT_SENDBUFFER_LENGTH + 3"
+#endif
+
+static uint8_t mqtt_outbox[MQTT_OUTBOX_LENGTH];
+static uint16_t mqtt_outbox_length;     // bytes used
+static uint16_t mqtt_outbox_sent;       // bytes in the send queue already
+static uint16_t mqtt_outbox_msg_id;
+
+#ifdef MQTT_OUTBOX_VFS_SUPPORT
+#ifndef MQTT_OUTBOX_FILENAME
+#define MQTT_OUTBOX_FILENAME "mqtt.q"
+#endif
+
+static vfs_size_t mqtt_outbox_file_read;        // next record in the file
+static bool mqtt_outbox_file_empty;     // unknown after reset
+#endif
+#endif
 
 
 /********************
@@ -181,6 +231,22 @@ bool mqtt_construct_unsubscribe_packet_P(PGM_P topic);
 bool mqtt_construct_zerolength_packet(uint8_t msg_type);
 bool mqtt_construct_ack_packet(uint8_t msg_type, uint16_t msgid);
 
+#ifdef MQTT_OUTBOX_SUPPORT
+static void mqtt_outbox_set_msg_id(uint8_t * record);
+static bool mqtt_outbox_add(char const *topic, bool topic_P,
+                            const void *payload, uint16_t payload_length,
+                            bool retain);
+static void mqtt_outbox_send(void);
+static void mqtt_outbox_acked(uint16_t msgid);
+#ifdef MQTT_OUTBOX_VFS_SUPPORT
+static void mqtt_outbox_load(void);
+#endif
+bool mqtt_queue_publish_packet(char const *topic, const void *payload,
+                               uint16_t payload_length, bool retain);
+bool mqtt_queue_publish_packet_P(PGM_P topic, const void *payload,
+                                 uint16_t payload_length, bool retain);
+#endif
+
 static void mqtt_handle_packet(const void *data, uint8_t llen,
                                uint16_t packet_length);
 static uint8_t mqtt_parse_length_field(uint16_t * length, const void *buffer,
@@ -239,6 +305,9 @@ mqtt_reset_state(void)
   mqtt_ping_outstanding = false;
   mqtt_last_in_activity = mqtt_last_out_activity = mqtt_timer_counter;
   STATE->stage = MQTT_STATE_DISCONNECTED;
+#ifdef MQTT_OUTBOX_SUPPORT
+  mqtt_outbox_sent = 0;         // send everything again
+#endif
 }
 
 // the message id must not be 0
@@ -323,6 +392,21 @@ mqtt_buffer_free(uint16_t length)
 static void
 mqtt_flush_buffer(void)
 {
+  if (uip_windowed(uip_conn))
+  {
+    // uip keeps a copy of the data in flight, send as much as the window
+    // allows and forget about it
+    uint8_t length = minimum(mqtt_send_buffer_current_head, uip_mss());
+    if (length > 0)
+    {
+      uip_send(mqtt_send_buffer, length);
+      mqtt_send_buffer_last_length = length;
+      mqtt_received_ack();
+      mqtt_last_out_activity = mqtt_timer_counter;
+    }
+    return;
+  }
+
   if (mqtt_send_buffer_last_length == 0 // no data waiting for a uip_ack
       && mqtt_send_buffer_current_head > 0)
   {
@@ -746,6 +830,278 @@ mqtt_construct_ack_packet(uint8_t msg_type, uint16_t msgid)
 }
 
 
+#ifdef MQTT_OUTBOX_SUPPORT
+
+/*********************
+ *                   *
+ *      Outbox       *
+ *                   *
+ *********************/
+
+// give the record a new message id, in the record header and in the packet
+static void
+mqtt_outbox_set_msg_id(uint8_t * record)
+{
+  uint8_t *packet = record + MQTT_OUTBOX_HEADER;
+  uint16_t length;
+  uint8_t llen = mqtt_parse_length_field(&length, packet + 1, 3);
+  uint8_t *msgid = packet + 1 + llen + 2 + (packet[1 + llen] << 8)
+    + packet[1 + llen + 1];
+
+  // keep clear of the ids of subscriptions, which start over at 1
+  mqtt_outbox_msg_id = (mqtt_outbox_msg_id + 1) | 0x8000;
+
+  record[2] = msgid[0] = HI8(mqtt_outbox_msg_id);
+  record[3] = msgid[1] = LO8(mqtt_outbox_msg_id);
+}
+
+#ifdef MQTT_OUTBOX_VFS_SUPPORT
+// write data (from program space) to the spill file
+static bool
+mqtt_outbox_write_file(struct vfs_file_handle_t *file, const void *data,
+                       uint16_t length, bool data_P)
+{
+  uint8_t buf[16];
+
+  while (length > 0)
+  {
+    uint8_t chunk = minimum(length, sizeof(buf));
+    if (data_P)
+      memcpy_P(buf, data, chunk);
+    else
+      memcpy(buf, data, chunk);
+
+    if (vfs_write(file, buf, chunk) != chunk)
+      return false;
+
+    data += chunk;
+    length -= chunk;
+  }
+
+  return true;
+}
+
+// move records from the spill file to the outbox, as far as there is room
+static void
+mqtt_outbox_load(void)
+{
+  struct vfs_file_handle_t *file = vfs_open(MQTT_OUTBOX_FILENAME);
+  if (file == NULL)
+  {
+    mqtt_outbox_file_empty = true;
+    return;
+  }
+
+  vfs_size_t size = vfs_size(file);
+  while (mqtt_outbox_file_read + MQTT_OUTBOX_HEADER <= size)
+  {
+    uint8_t *record = mqtt_outbox + mqtt_outbox_length;
+    if (mqtt_outbox_length + MQTT_OUTBOX_HEADER > MQTT_OUTBOX_LENGTH
+        || vfs_pread(file, record, MQTT_OUTBOX_HEADER,
+                     mqtt_outbox_file_read) != MQTT_OUTBOX_HEADER)
+      break;
+
+    uint16_t length = (record[0] << 8) + record[1];
+    if (mqtt_outbox_length + MQTT_OUTBOX_HEADER + length > MQTT_OUTBOX_LENGTH)
+      break;
+    if (vfs_pread(file, record + MQTT_OUTBOX_HEADER, length,
+                  mqtt_outbox_file_read + MQTT_OUTBOX_HEADER) != length)
+    {
+      // broken record, give up on the rest of the file
+      mqtt_outbox_file_read = size;
+      break;
+    }
+
+    mqtt_outbox_set_msg_id(record);
+    mqtt_outbox_length += MQTT_OUTBOX_HEADER + length;
+    mqtt_outbox_file_read += MQTT_OUTBOX_HEADER + length;
+  }
+
+  if (mqtt_outbox_file_read >= size)
+  {
+    MQTTDEBUG("outbox file empty\n");
+    mqtt_outbox_file_read = 0;
+    mqtt_outbox_file_empty = true;
+    vfs_truncate(file, 0);
+  }
+
+  vfs_close(file);
+}
+#endif
+
+// queue a publish packet in the outbox (or the spill file)
+// return false if there is no room left
+static bool
+mqtt_outbox_add(char const *topic, bool topic_P, const void *payload,
+                uint16_t payload_length, bool retain)
+{
+  uint16_t topic_length = topic_P ? strlen_P(topic) : strlen(topic);
+  uint16_t length = 2 + topic_length + 2 + payload_length;
+  uint8_t header[MQTT_OUTBOX_HEADER + 1 + 3 + 2];
+  uint8_t hlen = MQTT_OUTBOX_HEADER;
+
+  // fixed header and topic length, the message id is set later
+  header[hlen++] = MQTTPUBLISH | MQTTQOS1 | (retain ? 1 : 0);
+  hlen += mqtt_buffer_write_length_field(header + hlen, length);
+  header[hlen++] = HI8(topic_length);
+  header[hlen++] = LO8(topic_length);
+
+  uint16_t packet_length = hlen - MQTT_OUTBOX_HEADER + length - 2;
+  header[0] = HI8(packet_length);
+  header[1] = LO8(packet_length);
+  header[2] = header[3] = 0;
+
+  // the packet has to fit into the send queue and into the outbox as a
+  // whole, a record in the file that never fits would block all behind it
+  if (packet_length >= MQTT_SENDBUFFER_LENGTH
+      || packet_length > MQTT_OUTBOX_LENGTH - MQTT_OUTBOX_HEADER)
+    return false;
+
+  uint8_t msgid[2] = { 0, 0 };
+
+#ifdef MQTT_OUTBOX_VFS_SUPPORT
+  // keep the order, nothing goes past records in the file
+  if (!mqtt_outbox_file_empty)
+    mqtt_outbox_load();
+
+  if (!mqtt_outbox_file_empty
+      || mqtt_outbox_length + MQTT_OUTBOX_HEADER + packet_length
+      > MQTT_OUTBOX_LENGTH)
+  {
+    struct vfs_file_handle_t *file = vfs_open(MQTT_OUTBOX_FILENAME);
+    if (file == NULL)
+      file = vfs_create(MQTT_OUTBOX_FILENAME);
+    if (file == NULL)
+      return false;
+
+    vfs_size_t size = vfs_size(file);
+    bool ok = size + MQTT_OUTBOX_HEADER + packet_length
+      <= MQTT_OUTBOX_VFS_MAXSIZE
+      && vfs_fseek(file, size, SEEK_SET) == 0
+      && mqtt_outbox_write_file(file, header, hlen, false)
+      && mqtt_outbox_write_file(file, topic, topic_length, topic_P)
+      && mqtt_outbox_write_file(file, msgid, 2, false)
+      && mqtt_outbox_write_file(file, payload, payload_length, false);
+
+    // don't leave half a record behind
+    if (!ok && vfs_size(file) > size)
+      vfs_truncate(file, size);
+    vfs_close(file);
+
+    if (!ok)
+    {
+      MQTTDEBUG("outbox file full\n");
+      return false;
+    }
+
+    mqtt_outbox_file_empty = false;
+    return true;
+  }
+#else
+  if (mqtt_outbox_length + MQTT_OUTBOX_HEADER + packet_length
+      > MQTT_OUTBOX_LENGTH)
+  {
+    MQTTDEBUG("outbox full\n");
+    return false;
+  }
+#endif
+
+  uint8_t *record = mqtt_outbox + mqtt_outbox_length;
+  uint8_t *p = record;
+
+  memcpy(p, header, hlen);
+  p += hlen;
+  if (topic_P)
+    memcpy_P(p, topic, topic_length);
+  else
+    memcpy(p, topic, topic_length);
+  p += topic_length;
+  memcpy(p, msgid, 2);
+  memcpy(p + 2, payload, payload_length);
+
+  mqtt_outbox_set_msg_id(record);
+  mqtt_outbox_length += MQTT_OUTBOX_HEADER + packet_length;
+
+  return true;
+}
+
+// put the records not sent on this connection yet into the send queue
+static void
+mqtt_outbox_send(void)
+{
+  while (mqtt_outbox_sent < mqtt_outbox_length)
+  {
+    uint8_t *record = mqtt_outbox + mqtt_outbox_sent;
+    uint16_t length = (record[0] << 8) + record[1];
+
+    // skip records already acknowledged
+    if (record[2] || record[3])
+    {
+      if (!mqtt_buffer_free(length))
+        break;
+
+      mqtt_buffer_write_data(record + MQTT_OUTBOX_HEADER, length);
+      // any further copy is a duplicate
+      record[MQTT_OUTBOX_HEADER] |= MQTT_DUP_FLAG;
+    }
+
+    mqtt_outbox_sent += MQTT_OUTBOX_HEADER + length;
+  }
+}
+
+// the broker acknowledged a publish packet, drop it from the outbox
+static void
+mqtt_outbox_acked(uint16_t msgid)
+{
+  uint16_t pos = 0;
+  uint16_t done = 0;            // acknowledged records at the front
+
+  while (pos < mqtt_outbox_sent)
+  {
+    uint8_t *record = mqtt_outbox + pos;
+    uint16_t id = (record[2] << 8) + record[3];
+
+    if (id == msgid)
+      record[2] = record[3] = 0;
+    if (done == pos && record[2] == 0 && record[3] == 0)
+      done += MQTT_OUTBOX_HEADER + (record[0] << 8) + record[1];
+
+    pos += MQTT_OUTBOX_HEADER + (record[0] << 8) + record[1];
+  }
+
+  if (done == 0)
+    return;
+
+  memmove(mqtt_outbox, mqtt_outbox + done, mqtt_outbox_length - done);
+  mqtt_outbox_length -= done;
+  mqtt_outbox_sent -= done;
+
+#ifdef MQTT_OUTBOX_VFS_SUPPORT
+  if (!mqtt_outbox_file_empty)
+    mqtt_outbox_load();
+#endif
+}
+
+// queue a publish packet with QoS 1, it is sent until the broker acknowledges
+// it, across reconnects, too
+// return false if the outbox is full
+bool
+mqtt_queue_publish_packet(char const *topic, const void *payload,
+                          uint16_t payload_length, bool retain)
+{
+  return mqtt_outbox_add(topic, false, payload, payload_length, retain);
+}
+
+bool
+mqtt_queue_publish_packet_P(PGM_P topic, const void *payload,
+                            uint16_t payload_length, bool retain)
+{
+  return mqtt_outbox_add(topic, true, payload, payload_length, retain);
+}
+
+#endif /* MQTT_OUTBOX_SUPPORT */
+
+
 /***********************
  *                     *
  *  Receiving Packets  *
@@ -795,6 +1151,12 @@ mqtt_handle_packet(const void *data, uint8_t llen, uint16_t packet_length)
     MQTTDEBUG("connack received\n");
     STATE->stage = MQTT_STATE_CONNECTED;
 
+#if defined(MQTT_OUTBOX_SUPPORT) && defined(MQTT_OUTBOX_VFS_SUPPORT)
+    // records spilled before a reset are only known to the file
+    if (!mqtt_outbox_file_empty)
+      mqtt_outbox_load();
+#endif
+
     // auto subscribe
     if (mqtt_con_config->auto_subscribe_topics)
       for (uint8_t i = 0; mqtt_con_config->auto_subscribe_topics[i] != NULL;
@@ -872,7 +1234,11 @@ mqtt_handle_packet(const void *data, uint8_t llen, uint16_t packet_length)
 
 
       case MQTTPUBACK:
-        break;                  // hmm 'kay
+#ifdef MQTT_OUTBOX_SUPPORT
+        if (packet_length >= 2)
+          mqtt_outbox_acked(packet[0] * 256 + packet[1]);
+#endif
+        break;
 
 
       case MQTTPUBREC:
@@ -1286,14 +1652,14 @@ mqtt_main(void)
   {
     MQTTDEBUG("new connection\n");
 
+    // nothing is outstanding yet, let uip keep the segments in flight
+    uip_set_windowed();
+
     mqtt_construct_connect_packet();
 
     // init
     mqtt_next_msg_id = 1;
     STATE->stage = MQTT_STATE_CONNECT;
-
-    // send
-    mqtt_flush_buffer();
   }
 
   if (uip_acked())
@@ -1317,8 +1683,13 @@ mqtt_main(void)
   else if (uip_poll() && STATE->stage == MQTT_STATE_CONNECTED)
   {
     MQTTDEBUG("mqtt main poll\n");
-    mqtt_poll();
-    mqtt_flush_buffer();
+    // a windowed connection is polled again as long as it sends, keep
+    // the keepalive and the poll callbacks at one run per timer tick
+    if (mqtt_last_poll != mqtt_timer_counter)
+    {
+      mqtt_last_poll = mqtt_timer_counter;
+      mqtt_poll();
+    }
   }
 
   else if (uip_poll() && STATE->stage == MQTT_STATE_CONNECT)
@@ -1331,6 +1702,17 @@ mqtt_main(void)
       return;
     }
   }
+
+  // send the queue, right after an ack or an incoming packet, too
+  if (!uip_rexmit() && mqtt_uip_conn != NULL
+      && STATE->stage != MQTT_STATE_DISCONNECTED)
+  {
+#ifdef MQTT_OUTBOX_SUPPORT
+    if (STATE->stage == MQTT_STATE_CONNECTED)
+      mqtt_outbox_send();
+#endif
+    mqtt_flush_buffer();
+  }
 }
 
 
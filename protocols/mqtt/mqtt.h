@@ -133,6 +133,16 @@ bool mqtt_construct_unsubscribe_packet_P(PGM_P topic);
 bool mqtt_construct_zerolength_packet(uint8_t msg_type);
 bool mqtt_construct_ack_packet(uint8_t msg_type, uint16_t msgid);
 
+#ifdef MQTT_OUTBOX_SUPPORT
+// put a QoS 1 publish packet in the outbox, may be called while not
+// connected, it is sent until the broker acknowledges it
+// return false if the outbox is full
+bool mqtt_queue_publish_packet(char const *topic, const void *payload,
+                               uint16_t payload_length, bool retain);
+bool mqtt_queue_publish_packet_P(PGM_P topic, const void *payload,
+                                 uint16_t payload_length, bool retain);
+#endif
+
 
 // INTERNAL
 void mqtt_periodic(void);
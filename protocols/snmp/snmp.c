@@ -47,6 +47,10 @@
 #include "services/tanklevel/tanklevel.h"
 #endif
 
+#ifdef PERIODIC_STATS_SUPPORT
+#include "core/periodic_stats.h"
+#endif
+
 #ifdef SNMP_SUPPORT
 
 /**********************************************************
@@ -324,6 +328,68 @@ dht_next(uint8_t * ptr, struct snmp_varbinding * bind)
 }
 #endif
 
+#ifdef PERIODIC_STATS_SUPPORT
+enum
+{
+  TIMER_NAME = 1,
+  TIMER_RUNS,
+  TIMER_MISSED,
+  TIMER_LATE,                   /* one column per histogram bucket */
+  TIMER_RUN_AVG = TIMER_LATE + PERIODIC_STATS_BUCKETS,
+  TIMER_RUN_MAX,
+};
+
+uint8_t
+timer_reaction(uint8_t * ptr, struct snmp_varbinding * bind, void *userdata)
+{
+  if (bind->len != 1 || bind->data[0] >= periodic_stats_max)
+  {
+    return 0;
+  }
+  uint8_t i = bind->data[0];
+  uint8_t column = (uint16_t) userdata;
+  periodic_stats_t *stats = &periodic_stats[i];
+
+  switch (column)
+  {
+    case TIMER_NAME:
+    {
+      PGM_P name = periodic_stats_name(i);
+      ptr[0] = SNMP_TYPE_STRING;
+      if (name)
+      {
+        ptr[1] = strlen_P(name);
+        memcpy_P(ptr + 2, name, ptr[1]);
+      }
+      else
+      {
+        ptr[1] = snprintf_P((char *) (ptr + 2), 12, PSTR("dynamic %u"),
+                            i - periodic_stats_names_max);
+      }
+      return ptr[1] + 2;
+    }
+    case TIMER_RUNS:
+      return encode_long(ptr, SNMP_TYPE_GAUGE, stats->runs);
+    case TIMER_MISSED:
+      return encode_long(ptr, SNMP_TYPE_GAUGE, stats->missed);
+    case TIMER_RUN_AVG:
+      return encode_long(ptr, SNMP_TYPE_GAUGE,
+                         stats->runs ? stats->run_sum / stats->runs : 0);
+    case TIMER_RUN_MAX:
+      return encode_long(ptr, SNMP_TYPE_GAUGE, stats->run_max);
+    default:
+      return encode_long(ptr, SNMP_TYPE_GAUGE,
+                         stats->late[column - TIMER_LATE]);
+  }
+}
+
+uint8_t
+timer_next(uint8_t * ptr, struct snmp_varbinding * bind)
+{
+  return onelevel_next(ptr, bind, periodic_stats_max);
+}
+#endif
+
 uint8_t
 string_pgm_reaction(uint8_t * ptr, struct snmp_varbinding * bind,
                     void *userdata)
@@ -387,6 +453,18 @@ const char dht_temp_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x05\x02";
 const char dht_humid_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x05\x03";
 #endif
 
+#ifdef PERIODIC_STATS_SUPPORT
+const char timer_name_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x01";
+const char timer_runs_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x02";
+const char timer_missed_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x03";
+const char timer_late0_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x04";
+const char timer_late1_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x05";
+const char timer_late2_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x06";
+const char timer_late3_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x07";
+const char timer_run_avg_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x08";
+const char timer_run_max_obj_name[] PROGMEM = SNMP_OID_ETHERSEX "\x06\x09";
+#endif
+
 const struct snmp_reaction snmp_reactions[] PROGMEM = {
   {desc_obj_name, string_pgm_reaction, (void *) desc_value, NULL},
 #if defined(WHM_SUPPORT) || defined(UPTIME_SUPPORT)
@@ -417,6 +495,17 @@ const struct snmp_reaction snmp_reactions[] PROGMEM = {
   {dht_polling_delay_obj_name, dht_polling_delay_reaction, NULL, dht_next},
   {dht_temp_obj_name, dht_temp_reaction, NULL, dht_next},
   {dht_humid_obj_name, dht_humid_reaction, NULL, dht_next},
+#endif
+#ifdef PERIODIC_STATS_SUPPORT
+  {timer_name_obj_name, timer_reaction, (void *) TIMER_NAME, timer_next},
+  {timer_runs_obj_name, timer_reaction, (void *) TIMER_RUNS, timer_next},
+  {timer_missed_obj_name, timer_reaction, (void *) TIMER_MISSED, timer_next},
+  {timer_late0_obj_name, timer_reaction, (void *) TIMER_LATE, timer_next},
+  {timer_late1_obj_name, timer_reaction, (void *) (TIMER_LATE + 1), timer_next},
+  {timer_late2_obj_name, timer_reaction, (void *) (TIMER_LATE + 2), timer_next},
+  {timer_late3_obj_name, timer_reaction, (void *) (TIMER_LATE + 3), timer_next},
+  {timer_run_avg_obj_name, timer_reaction, (void *) TIMER_RUN_AVG, timer_next},
+  {timer_run_max_obj_name, timer_reaction, (void *) TIMER_RUN_MAX, timer_next},
 #endif
   {NULL, NULL, NULL, NULL}
 };
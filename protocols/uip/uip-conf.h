@@ -75,7 +75,11 @@ typedef unsigned short uip_stats_t;
  *
  * \hideinitializer
  */
+#ifdef CONF_UIP_MAX_CONNECTIONS
+#define UIP_CONF_MAX_CONNECTIONS CONF_UIP_MAX_CONNECTIONS
+#else
 #define UIP_CONF_MAX_CONNECTIONS 3
+#endif
 
 /**
  * Maximum number of listening TCP ports.
@@ -123,7 +127,11 @@ typedef unsigned short uip_stats_t;
 #   define UIP_CONF_UDP             0
 #endif
 
+#ifdef CONF_UIP_UDP_CONNS
+#define UIP_CONF_UDP_CONNS            CONF_UIP_UDP_CONNS
+#else
 #define UIP_CONF_UDP_CONNS            5
+#endif
 
 /**
  * UDP checksums on or off
@@ -160,7 +168,11 @@ typedef unsigned short uip_stats_t;
 #endif
 
 #define UIP_ARCH_ADD32           0
-#define UIP_ARCH_CHKSUM          0
+#ifdef UIP_FAST_CHKSUM_SUPPORT
+#  define UIP_ARCH_CHKSUM        1
+#else
+#  define UIP_ARCH_CHKSUM        0
+#endif
 
 #define RFM12_LLH_LEN            2
 
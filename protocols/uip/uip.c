@@ -82,6 +82,7 @@
 
 #include "uip.h"
 #include "uipopt.h"
+#include "uip_chksum.h"
 #include "protocols/uip/ipv6.h"
 #include "protocols/zbus/zbus.h"
 #include "core/debug.h"
@@ -199,6 +200,88 @@ u16_t lastport;              /* Keeps track of the last port used for
 				a new connection. */
 #endif /* UIP_ACTIVE_OPEN */
 
+#ifdef UIP_CONN_HASH_SUPPORT
+/* Chained hash indices over the connection tables.  For every table
+   there is a list head per bucket, a next pointer per slot and the
+   bucket each slot is currently linked into (UIP_HASH_NIL if none).
+   Slots are only (re)linked when their key changes; entries whose
+   connection has since been closed are skipped by the lookup. */
+#define UIP_HASH_NIL  0xff
+#define UIP_HASH_MASK (CONF_UIP_HASH_BUCKETS - 1)
+
+#if UIP_CONNS >= UIP_HASH_NIL || UIP_UDP_CONNS >= UIP_HASH_NIL \
+  || UIP_LISTENPORTS >= UIP_HASH_NIL
+#error "connection hash supports at most 254 slots per table"
+#endif
+#if (CONF_UIP_HASH_BUCKETS & UIP_HASH_MASK) != 0
+#error "CONF_UIP_HASH_BUCKETS must be a power of two"
+#endif
+
+#define UIP_HASH_INDEX(name, size)			\
+  static u8_t name##_head[CONF_UIP_HASH_BUCKETS];	\
+  static u8_t name##_next[size];			\
+  static u8_t name##_bucket[size]
+
+#define uip_hash_init(name)					\
+  do {								\
+    memset(name##_head, UIP_HASH_NIL, sizeof(name##_head));	\
+    memset(name##_bucket, UIP_HASH_NIL, sizeof(name##_bucket));	\
+  } while(0)
+#define uip_hash_link(name, b, i)				\
+  uip_hash_link_(name##_head, name##_next, name##_bucket, b, i)
+#define uip_hash_unlink(name, i)				\
+  uip_hash_unlink_(name##_head, name##_next, name##_bucket, i)
+
+#if UIP_TCP
+UIP_HASH_INDEX(uip_conn_hash, UIP_CONNS);
+UIP_HASH_INDEX(uip_listen_hash, UIP_LISTENPORTS);
+#endif
+#if UIP_UDP
+UIP_HASH_INDEX(uip_udp_hash, UIP_UDP_CONNS);
+#endif
+
+static u8_t
+uip_hash(u16_t h, const void *ipaddr)
+{
+  const u8_t *p = ipaddr;
+
+  if(p != NULL) {
+    for(u8_t i = 0; i < sizeof(uip_ipaddr_t); ++i) {
+      h += (u16_t) p[i] << ((i & 1) << 3);
+    }
+  }
+  return (h ^ (h >> 8)) & UIP_HASH_MASK;
+}
+
+static void
+uip_hash_unlink_(u8_t *head, u8_t *next, u8_t *bucket, u8_t i)
+{
+  if(bucket[i] == UIP_HASH_NIL) {
+    return;
+  }
+
+  u8_t *p = &head[bucket[i]];
+  while(*p != i) {
+    p = &next[*p];
+  }
+  *p = next[i];
+  bucket[i] = UIP_HASH_NIL;
+}
+
+static void
+uip_hash_link_(u8_t *head, u8_t *next, u8_t *bucket, u8_t b, u8_t i)
+{
+  uip_hash_unlink_(head, next, bucket, i);
+  next[i] = head[b];
+  head[b] = i;
+  bucket[i] = b;
+}
+
+#define uip_tcp_hash(lport, rport, ripaddr) \
+  uip_hash((lport) ^ (rport), (ripaddr))
+#define uip_port_hash(port) uip_hash(port, NULL)
+#endif /* UIP_CONN_HASH_SUPPORT */
+
 /* Structures and definitions. */
 #define TCP_FIN 0x01
 #define TCP_SYN 0x02
@@ -287,8 +370,188 @@ uip_add32(u8_t *op32, u16_t op16)
 }
 #endif /* ! UIP_ARCH_ADD32 && UIP_TCP*/
 
-#if ! UIP_ARCH_CHKSUM
+#if defined(UIP_REXMIT_BUFFER_SUPPORT) && UIP_TCP
+/* Copies of the segments in flight, so that retransmissions can be
+   served without calling upon the application.  The buffers of a
+   connection form a list in sequence number order, starting at
+   conn->rexmit.  A buffer belongs to a connection for as long as it is
+   on that list and the connection still has data outstanding;
+   everything else may be reused. */
+#define UIP_REXMIT_NONE 0xff
+
+#if CONF_UIP_REXMIT_BUFFERS >= UIP_REXMIT_NONE
+#error "at most 254 retransmit buffers are supported"
+#endif
+
+static struct {
+  uip_conn_t *conn;
+  u16_t len;
+  u8_t next;
+  u8_t data[UIP_TCP_MSS];
+} uip_rexmit_bufs[CONF_UIP_REXMIT_BUFFERS];
+
+static u8_t
+uip_rexmit_owned(u8_t i)
+{
+  uip_conn_t *owner = uip_rexmit_bufs[i].conn;
+  if(owner == NULL || !uip_outstanding(owner) ||
+     (owner->tcpstateflags & UIP_TS_MASK) != UIP_ESTABLISHED) {
+    return 0;
+  }
+
+  u8_t j = owner->rexmit;
+  for(u8_t n = 0; n < CONF_UIP_REXMIT_BUFFERS; ++n) {
+    if(j == UIP_REXMIT_NONE || uip_rexmit_bufs[j].conn != owner) {
+      break;
+    }
+    if(j == i) {
+      return 1;
+    }
+    j = uip_rexmit_bufs[j].next;
+  }
+  return 0;
+}
+
+static u8_t
+uip_rexmit_alloc(void)
+{
+  for(u8_t i = 0; i < CONF_UIP_REXMIT_BUFFERS; ++i) {
+    if(!uip_rexmit_owned(i)) {
+      return i;
+    }
+  }
+  return UIP_REXMIT_NONE;
+}
+
+/* Return the buffer holding the oldest unacknowledged segment. */
+static u8_t
+uip_rexmit_find(uip_conn_t *conn)
+{
+  u8_t i = conn->rexmit;
+  if(i == UIP_REXMIT_NONE || uip_rexmit_bufs[i].conn != conn) {
+    return UIP_REXMIT_NONE;
+  }
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  if(conn->windowed) {
+    return i;
+  }
+#endif
+  /* Without the windowed mode the one segment must cover all data. */
+  return uip_rexmit_bufs[i].len == conn->len ? i : UIP_REXMIT_NONE;
+}
+
+/* Keep a copy of a segment just sent, appending it to the list of the
+   connection. */
+static void
+uip_rexmit_save(uip_conn_t *conn, const void *data, u16_t len)
+{
+  u8_t i = uip_rexmit_alloc();
+  if(i == UIP_REXMIT_NONE) {
+    /* All buffers busy, the application has to retransmit itself. */
+    return;
+  }
+
+  uip_rexmit_bufs[i].conn = conn;
+  uip_rexmit_bufs[i].len = len;
+  uip_rexmit_bufs[i].next = UIP_REXMIT_NONE;
+  memcpy(uip_rexmit_bufs[i].data, data, len);
+
+  u8_t *p = &conn->rexmit;
+  while(*p != UIP_REXMIT_NONE && uip_rexmit_bufs[*p].conn == conn) {
+    p = &uip_rexmit_bufs[*p].next;
+  }
+  *p = i;
+}
+
+#ifdef UIP_TCP_WINDOW_SUPPORT
+/* Connection the segment passed to uip_tcp_input() has been delivered
+   to, NULL if it was not for an open TCP connection. */
+static uip_conn_t *uip_input_conn;
+
+static uint32_t
+uip_seq32(const u8_t *seq)
+{
+  return ((uint32_t) seq[0] << 24) | ((uint32_t) seq[1] << 16) |
+    ((u16_t) seq[2] << 8) | seq[3];
+}
+
+/* Process the cumulative ACK `ackno' on a windowed connection: release
+   all segments it covers completely and move snd_nxt past them.
+   Returns non-zero if anything has been acknowledged. */
+static u8_t
+uip_tcp_window_ack(uip_conn_t *conn, const u8_t *ackno)
+{
+  uint32_t acked = uip_seq32(ackno) - uip_seq32(conn->snd_nxt);
+  u16_t n = 0;
+
+  /* ACKs for data we haven't sent yet are bogus, old ones (which wrap
+     around to huge values) are just duplicates. */
+  if(acked > conn->len) {
+    return 0;
+  }
+
+  while(conn->rexmit != UIP_REXMIT_NONE &&
+	uip_rexmit_bufs[conn->rexmit].len <= acked) {
+    u8_t i = conn->rexmit;
+    acked -= uip_rexmit_bufs[i].len;
+    n += uip_rexmit_bufs[i].len;
+    conn->rexmit = uip_rexmit_bufs[i].next;
+    uip_rexmit_bufs[i].conn = NULL;
+  }
+
+  if(n == 0) {
+    return 0;
+  }
+
+  uip_add32(conn->snd_nxt, n);
+  memcpy(conn->snd_nxt, uip_acc32, 4);
+  conn->len -= n;
+  return 1;
+}
+
+/* Number of bytes the windowed connection may send right now, limited
+   by the peer's window, the MSS and the availability of a buffer. */
+static u16_t
+uip_tcp_room(uip_conn_t *conn)
+{
+  u16_t wnd = conn->snd_wnd;
+
+  /* Zero window probe, just like uIP does it otherwise. */
+  if(wnd == 0 && conn->len == 0) {
+    wnd = conn->initialmss;
+  }
+
+  if(wnd <= conn->len || uip_rexmit_alloc() == UIP_REXMIT_NONE) {
+    return 0;
+  }
+  wnd -= conn->len;
+  return wnd > conn->initialmss ? conn->initialmss : wnd;
+}
+
+/* Segments of a windowed connection carry snd_nxt plus the data in
+   flight, only the retransmission of the oldest one starts at snd_nxt. */
+#define UIP_SEQOFF_INFLIGHT 0xffff
+
+#define uip_tcp_window_mss(conn)			\
+  do {							\
+    if((conn)->windowed) {				\
+      (conn)->mss = uip_tcp_room(conn);			\
+    }							\
+  } while(0)
+#define uip_tcp_can_poll(conn)				\
+  ((conn)->windowed ? uip_tcp_room(conn) != 0 : !uip_outstanding(conn))
+#endif /* UIP_TCP_WINDOW_SUPPORT */
+#endif /* UIP_REXMIT_BUFFER_SUPPORT && UIP_TCP */
+
+#ifndef UIP_TCP_WINDOW_SUPPORT
+#define uip_tcp_window_mss(conn)  do { } while(0)
+#define uip_tcp_can_poll(conn)    (!uip_outstanding(conn))
+#endif
+
 /*---------------------------------------------------------------------------*/
+#if UIP_ARCH_CHKSUM
+#define chksum uip_arch_chksum
+#else /* UIP_ARCH_CHKSUM */
 static u16_t
 noinline chksum(u16_t sum, const u8_t *data, u16_t len)
 {
@@ -319,6 +582,7 @@ noinline chksum(u16_t sum, const u8_t *data, u16_t len)
   /* Return sum in host byte order. */
   return sum;
 }
+#endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
 #if 0
 static u16_t
@@ -392,7 +656,6 @@ uip_udpchksum(void)
   return upper_layer_chksum(UIP_PROTO_UDP);
 }
 #endif /* UIP_UDP_CHECKSUMS && UIP_UDP*/
-#endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
 void
 uip_init(void)
@@ -421,6 +684,15 @@ uip_init(void)
   }
 #endif /* UIP_UDP */
 
+#ifdef UIP_CONN_HASH_SUPPORT
+#if UIP_TCP
+  uip_hash_init(uip_conn_hash);
+  uip_hash_init(uip_listen_hash);
+#endif
+#if UIP_UDP
+  uip_hash_init(uip_udp_hash);
+#endif
+#endif /* UIP_CONN_HASH_SUPPORT */
 
 }
 /*---------------------------------------------------------------------------*/
@@ -504,6 +776,13 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
   conn->wnd = 0; /* unset the personal window size for this connection */
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+  conn->rexmit = UIP_REXMIT_NONE;
+#endif
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  conn->windowed = 0;
+  conn->snd_wnd = 0;
+#endif
   conn->lport = htons(lastport);
   conn->rport = rport;
 
@@ -513,6 +792,12 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
 
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
 
+#ifdef UIP_CONN_HASH_SUPPORT
+  uip_hash_link(uip_conn_hash,
+		uip_tcp_hash(conn->lport, conn->rport, conn->ripaddr),
+		conn - uip_conns);
+#endif
+
   /* Add callback to connection */
   conn->callback = callback;
 
@@ -565,7 +850,7 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
     return 0;
   }
 
-  conn->lport = HTONS(lastport);
+  uip_udp_bind(conn, HTONS(lastport));
   conn->rport = rport;
   if(ripaddr == NULL) {
     memset(conn->ripaddr, 0, sizeof(uip_ipaddr_t));
@@ -583,19 +868,52 @@ uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callback_t callback)
   return conn;
 }
 #endif /* UIP_ACTIVE_OPEN */
+#ifdef UIP_CONN_HASH_SUPPORT
+void
+uip_udp_bind(uip_udp_conn_t *conn, u16_t port)
+{
+  u8_t c = conn - uip_udp_conns;
+
+  conn->lport = port;
+  if(port == 0) {
+    uip_hash_unlink(uip_udp_hash, c);
+  } else {
+    uip_hash_link(uip_udp_hash, uip_port_hash(port), c);
+  }
+}
+#endif /* UIP_CONN_HASH_SUPPORT */
 #endif /* UIP_UDP */
 /*---------------------------------------------------------------------------*/
 #if UIP_TCP
-#ifndef TEENSY_SUPPORT
-void
-uip_unlisten(u16_t port)
+/* Return the uip_listenports slot listening on port, or UIP_LISTENPORTS
+   if there is none. */
+static u8_t
+uip_listen_find(u16_t port)
 {
+#ifdef UIP_CONN_HASH_SUPPORT
+  for(u8_t c = uip_listen_hash_head[uip_port_hash(port)];
+      c != UIP_HASH_NIL; c = uip_listen_hash_next[c]) {
+#else
   for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
+#endif
     if(uip_listenports[c].port == port) {
-      uip_listenports[c].port = 0;
-      return;
+      return c;
     }
   }
+  return UIP_LISTENPORTS;
+}
+/*---------------------------------------------------------------------------*/
+#ifndef TEENSY_SUPPORT
+void
+uip_unlisten(u16_t port)
+{
+  u8_t c = uip_listen_find(port);
+  if(c < UIP_LISTENPORTS) {
+    uip_listenports[c].port = 0;
+#ifdef UIP_CONN_HASH_SUPPORT
+    uip_hash_unlink(uip_listen_hash, c);
+#endif
+  }
 }
 #endif /* !TEENSY_SUPPORT */
 /*---------------------------------------------------------------------------*/
@@ -606,6 +924,9 @@ uip_listen(u16_t port, uip_conn_callback_t callback)
     if(uip_listenports[c].port == 0) {
       uip_listenports[c].port = port;
       uip_listenports[c].callback = callback;
+#ifdef UIP_CONN_HASH_SUPPORT
+      uip_hash_link(uip_listen_hash, uip_port_hash(port), c);
+#endif
       return;
     }
   }
@@ -660,9 +981,33 @@ uip_ipaddr_prefixlencmp(uip_ip6addr_t _a, uip_ip6addr_t _b, u8_t prefix)
 }
 #endif /* UIP_MULTI_STACK */
 /*---------------------------------------------------------------------------*/
+#if UIP_TCP
+static void
+uip_tcp_rtt_estimate(uip_conn_t *conn)
+{
+  signed char m;
+  m = conn->rto - conn->timer;
+  /* This is taken directly from VJs original code in his paper */
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+#endif /* UIP_TCP */
+/*---------------------------------------------------------------------------*/
 void
 uip_process(u8_t flag)
 {
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  /* Offset of the segment to send relative to snd_nxt, by default
+     behind all data in flight. */
+  u16_t seqoff = UIP_SEQOFF_INFLIGHT;
+#endif
+
 #if UIP_UDP
   if(flag == UIP_UDP_SEND_CONN) {
     goto udp_send;
@@ -678,7 +1023,11 @@ uip_process(u8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       uip_tcp_can_poll(uip_connr)) {
+	uip_tcp_window_mss(uip_connr);
+	/* Don't let the previous packet be taken for the application's
+	   data, uip_tcp_input() polls right after sending one. */
+	uip_len = uip_slen = 0;
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
@@ -781,6 +1130,21 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 
 	  case UIP_ESTABLISHED:
+#ifdef UIP_TCP_WINDOW_SUPPORT
+	    seqoff = 0;
+#endif
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+	    /* If we kept a copy of the segment, resend it without
+	       bothering the application. */
+	    {
+	      u8_t i = uip_rexmit_find(uip_connr);
+	      if(i != UIP_REXMIT_NONE) {
+		uip_slen = uip_rexmit_bufs[i].len;
+		memcpy(uip_sappdata, uip_rexmit_bufs[i].data, uip_slen);
+		goto apprexmit;
+	      }
+	    }
+#endif /* UIP_REXMIT_BUFFER_SUPPORT */
 	    /* In the ESTABLISHED state, we call upon the application
                to do the actual retransmit after which we jump into
                the code for sending out the packet (the apprexmit
@@ -797,9 +1161,21 @@ uip_process(u8_t flag)
 
 	  }
 	}
+#ifdef UIP_TCP_WINDOW_SUPPORT
+	/* A windowed connection may send more while waiting for the
+	   ACK, if the window has room left. */
+	else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+		uip_connr->windowed && uip_tcp_can_poll(uip_connr)) {
+	  uip_tcp_window_mss(uip_connr);
+	  uip_flags = UIP_POLL;
+	  UIP_APPCALL();
+	  goto appsend;
+	}
+#endif /* UIP_TCP_WINDOW_SUPPORT */
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
+	uip_tcp_window_mss(uip_connr);
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
@@ -995,11 +1371,9 @@ ip_check_end:
 
   ICMPBUF->type = ICMP_ECHO_REPLY;
 
-  if(ICMPBUF->icmpchksum >= HTONS(0xffff - (ICMP_ECHO << 8))) {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8) + 1;
-  } else {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8);
-  }
+  ICMPBUF->icmpchksum = uip_chksum_adjust(ICMPBUF->icmpchksum,
+					  HTONS(ICMP_ECHO << 8),
+					  HTONS(ICMP_ECHO_REPLY << 8));
 
   /* Swap IP addresses. */
   uip_ipaddr_copy(BUF->destipaddr, BUF->srcipaddr);
@@ -1117,6 +1491,31 @@ ip_check_end:
 #endif /* UIP_UDP_CHECKSUMS */
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#ifdef UIP_CONN_HASH_SUPPORT
+  {
+    /* Walk the chain of connections bound to the destination port.
+       Keep the linear search's preference for the highest slot. */
+    u8_t best = UIP_HASH_NIL;
+    for(u8_t c = uip_udp_hash_head[uip_port_hash(UDPBUF->destport)];
+	c != UIP_HASH_NIL; c = uip_udp_hash_next[c]) {
+      uip_udp_conn = &uip_udp_conns[c];
+      if((best == UIP_HASH_NIL || c > best) &&
+	 uip_udp_conn->lport != 0 &&
+	 UDPBUF->destport == uip_udp_conn->lport &&
+	 (uip_udp_conn->rport == 0 ||
+	  UDPBUF->srcport == uip_udp_conn->rport) &&
+	 (uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_zeroes_addr) ||
+	  uip_ipaddr_cmp(uip_udp_conn->ripaddr, all_ones_addr) ||
+	  uip_ipaddr_cmp(BUF->srcipaddr, uip_udp_conn->ripaddr))) {
+	best = c;
+      }
+    }
+    if(best != UIP_HASH_NIL) {
+      uip_udp_conn = &uip_udp_conns[best];
+      goto udp_found;
+    }
+  }
+#else /* UIP_CONN_HASH_SUPPORT */
   for(uip_udp_conn = &uip_udp_conns[UIP_UDP_CONNS - 1];
       uip_udp_conn >= &uip_udp_conns[0];
       --uip_udp_conn) {
@@ -1137,6 +1536,7 @@ ip_check_end:
       goto udp_found;
     }
   }
+#endif /* UIP_CONN_HASH_SUPPORT */
   DEBUG_PRINTF("udp: no matching connection found, sport %hu, dport %hu\n",
                ntohs(UDPBUF->srcport), ntohs(UDPBUF->destport));
   goto drop;
@@ -1207,8 +1607,15 @@ ip_check_end:
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#ifdef UIP_CONN_HASH_SUPPORT
+  for(u8_t c = uip_conn_hash_head[uip_tcp_hash(BUF->destport, BUF->srcport,
+						BUF->srcipaddr)];
+      c != UIP_HASH_NIL; c = uip_conn_hash_next[c]) {
+    uip_connr = &uip_conns[c];
+#else
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
        BUF->destport == uip_connr->lport &&
        BUF->srcport == uip_connr->rport &&
@@ -1227,9 +1634,9 @@ ip_check_end:
 
   u16_t tmp16 = BUF->destport;
   /* Next, check listening connections. */
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c) {
-    if(tmp16 == uip_listenports[c].port)
-      goto found_listen;
+  u8_t listen_idx = uip_listen_find(tmp16);
+  if(listen_idx < UIP_LISTENPORTS) {
+    goto found_listen;
   }
 
   /* No matching connection found, so we send a RST packet. */
@@ -1323,11 +1730,7 @@ ip_check_end:
   uip_conn = uip_connr;
 
   /* Set callback to the given value in uip_listenports */
-  for(u8_t c = 0; c < UIP_LISTENPORTS; ++c)
-    if(tmp16 == uip_listenports[c].port) {
-      uip_conn->callback = uip_listenports[c].callback;
-      break;
-    }
+  uip_conn->callback = uip_listenports[listen_idx].callback;
 
 #if UIP_MULTI_STACK
   uip_conn->stack = uip_stack_get_active();
@@ -1339,10 +1742,23 @@ ip_check_end:
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
   uip_connr->wnd = 0; /* unset the personal window size for this connection */
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+  uip_connr->rexmit = UIP_REXMIT_NONE;
+#endif
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  uip_connr->windowed = 0;
+  uip_connr->snd_wnd = 0;
+#endif
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
   uip_ipaddr_copy(uip_connr->ripaddr, BUF->srcipaddr);
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
+#ifdef UIP_CONN_HASH_SUPPORT
+  uip_hash_link(uip_conn_hash,
+		uip_tcp_hash(uip_connr->lport, uip_connr->rport,
+			     uip_connr->ripaddr),
+		uip_connr - uip_conns);
+#endif
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1419,6 +1835,9 @@ ip_check_end:
   /* This label will be jumped to if we found an active connection. */
  found:
   uip_conn = uip_connr;
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  uip_input_conn = uip_connr;
+#endif
   uip_flags = 0;
   /* We do a very naive form of TCP reset processing; we just accept
      any RST and kill our connection. We should in fact check if the
@@ -1459,6 +1878,21 @@ ip_check_end:
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  if((BUF->flags & TCP_ACK) && uip_connr->windowed &&
+     (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+    /* Cumulative ACK processing, any number of segments may be
+       acknowledged at once. */
+    if(uip_tcp_window_ack(uip_connr, BUF->ackno)) {
+      if(uip_connr->nrtx == 0) {
+	uip_tcp_rtt_estimate(uip_connr);
+      }
+      uip_flags = UIP_ACKDATA;
+      uip_connr->timer = uip_connr->rto;
+      uip_connr->nrtx = 0;
+    }
+  } else
+#endif /* UIP_TCP_WINDOW_SUPPORT */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1475,18 +1909,7 @@ ip_check_end:
 
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-	signed char m;
-	m = uip_connr->rto - uip_connr->timer;
-	/* This is taken directly from VJs original code in his paper */
-	m = m - (uip_connr->sa >> 3);
-	uip_connr->sa += m;
-	if(m < 0) {
-	  m = -m;
-	}
-	m = m - (uip_connr->sv >> 2);
-	uip_connr->sv += m;
-	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+	uip_tcp_rtt_estimate(uip_connr);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -1495,6 +1918,9 @@ ip_check_end:
 
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+      uip_connr->rexmit = UIP_REXMIT_NONE;
+#endif
     }
 
   }
@@ -1661,6 +2087,9 @@ ip_check_end:
        "persistent timer" and uses the retransmission mechanim.
     */
     tmp16 = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+#ifdef UIP_TCP_WINDOW_SUPPORT
+    uip_connr->snd_wnd = tmp16;
+#endif
     if(tmp16 > uip_connr->initialmss ||
        tmp16 == 0) {
       tmp16 = uip_connr->initialmss;
@@ -1691,6 +2120,7 @@ ip_check_end:
                                                  cause we received data */
       }
 #endif
+      uip_tcp_window_mss(uip_connr);
       UIP_APPCALL();
 
     appsend:
@@ -1708,6 +2138,13 @@ ip_check_end:
 	goto tcp_send_nodata;
       }
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+      /* The FIN has to wait until everything in flight has been
+	 acknowledged; the application will ask again. */
+      if(uip_connr->windowed && uip_outstanding(uip_connr)) {
+	uip_flags &= ~UIP_CLOSE;
+      }
+#endif
       if(uip_flags & UIP_CLOSE) {
 	uip_slen = 0;
 	uip_connr->len = 1;
@@ -1717,6 +2154,23 @@ ip_check_end:
 	goto tcp_send_nodata;
       }
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+      if(uip_connr->windowed) {
+	/* New data is appended to what is already in flight, as far
+	   as the window allows.  Retransmissions never end up here. */
+	u16_t room = uip_tcp_room(uip_connr);
+	if(uip_slen > room) {
+	  uip_slen = room;
+	}
+	if(uip_slen > 0) {
+	  seqoff = uip_connr->len;
+	  uip_rexmit_save(uip_connr, uip_sappdata, uip_slen);
+	  uip_connr->len += uip_slen;
+	}
+	goto apprexmit;
+      }
+#endif /* UIP_TCP_WINDOW_SUPPORT */
+
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
 
@@ -1741,12 +2195,22 @@ ip_check_end:
 	  /* Remember how much data we send out now so that we know
 	     when everything has been acknowledged. */
 	  uip_connr->len = uip_slen;
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+	  uip_connr->rexmit = UIP_REXMIT_NONE;
+	  uip_rexmit_save(uip_connr, uip_sappdata, uip_slen);
+#endif
 	} else {
 
 	  /* If the application already had unacknowledged data, we
 	     make sure that the application does not send (i.e.,
 	     retransmit) out more than it previously sent out. */
 	  uip_slen = uip_connr->len;
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+	  u8_t i = uip_rexmit_find(uip_connr);
+	  if(i != UIP_REXMIT_NONE) {
+	    memcpy(uip_sappdata, uip_rexmit_bufs[i].data, uip_slen);
+	  }
+#endif
 	}
       }
       uip_connr->nrtx = 0;
@@ -1758,6 +2222,12 @@ ip_check_end:
       if(uip_slen > 0 && uip_connr->len > 0) {
 	/* Add the length of the IP and TCP headers. */
 	uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#ifdef UIP_TCP_WINDOW_SUPPORT
+	if(uip_connr->windowed) {
+	  /* Only one of possibly several segments in flight. */
+	  uip_len = uip_slen + UIP_TCPIP_HLEN;
+	}
+#endif
 	/* We always set the ACK flag in response packets. */
 	BUF->flags = TCP_ACK | TCP_PSH;
 	/* Send the packet. */
@@ -1864,6 +2334,16 @@ ip_check_end:
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  if(uip_connr->windowed &&
+     (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+    if(seqoff == UIP_SEQOFF_INFLIGHT) {
+      seqoff = uip_connr->len;
+    }
+    uip_add32(BUF->seqno, seqoff);
+    memcpy(BUF->seqno, uip_acc32, 4);
+  }
+#endif
 
   BUF->proto = UIP_PROTO_TCP;
 
@@ -1954,6 +2434,43 @@ uip_send(const void *data, int len)
   }
 }
 
+#ifdef UIP_TCP_WINDOW_SUPPORT
+void
+uip_set_windowed(void)
+{
+  uip_conn->windowed = 1;
+  uip_conn->mss = uip_tcp_room(uip_conn);
+}
+
+void
+uip_clear_windowed(void)
+{
+  uip_conn->windowed = 0;
+  uip_conn->mss = uip_conn->initialmss;
+}
+
+void
+uip_tcp_input(void)
+{
+  uip_input_conn = NULL;
+  uip_process(UIP_DATA);
+
+  /* An ACK may open the window for several segments, but uip_process()
+     only produces one.  Send it right away and keep polling the
+     connection for more as long as the window has room.  uip_conn is
+     left over from earlier processing unless the segment was for a
+     connection, so only the one it was delivered to is polled. */
+  uip_conn_t *conn = uip_input_conn;
+  if(conn == NULL || !conn->windowed) {
+    return;
+  }
+  for(u8_t n = 0; n < CONF_UIP_REXMIT_BUFFERS && uip_len > 0; ++n) {
+    router_output();
+    uip_poll_conn(conn);
+  }
+}
+#endif /* UIP_TCP_WINDOW_SUPPORT */
+
 #if UIP_TCP == 1
 void
 uip_tcp_timer(void)
@@ -279,7 +279,12 @@ void uip_setipid(u16_t id);
  *
  * \hideinitializer
  */
+#ifdef UIP_TCP_WINDOW_SUPPORT
+#define uip_input()        uip_tcp_input()
+void uip_tcp_input(void);
+#else
 #define uip_input()        uip_process(UIP_DATA)
+#endif
 
 /**
  * Periodic processing for a connection identified by its number.
@@ -641,6 +646,39 @@ void uip_send(const void *data, int len);
                                    uip_conn->tcpstateflags &= ~UIP_STOPPED; \
                               } while(0)
 
+/**
+ * Switch the current connection to windowed sending.
+ *
+ * A windowed connection may have several segments in flight.  uIP
+ * keeps a copy of each of them and retransmits on its own, so the
+ * application only ever produces new data and never sees
+ * uip_rexmit().  In return, uip_acked() only means that some of the
+ * data has been acknowledged, the application is polled while data is
+ * still outstanding, and uip_mss() tells how much may be sent right
+ * now (possibly zero).  uip_send() silently crops the data to
+ * uip_mss(), so anything that has to go out in one piece must be
+ * sized to it, the rest is lost.  uip_close() is deferred until
+ * everything has been acknowledged, the application has to close
+ * again then.
+ *
+ * Must be called while no data is outstanding, e.g. from the
+ * uip_connected() or an uip_acked() callback.  Without windowed send
+ * support this is a no-op.  uip_clear_windowed() switches back to one
+ * segment at a time, e.g. before the next request on a persistent
+ * connection, again with nothing outstanding.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_TCP_WINDOW_SUPPORT
+void uip_set_windowed(void);
+void uip_clear_windowed(void);
+#define uip_windowed(conn)    ((conn)->windowed)
+#else
+#define uip_set_windowed()    do { } while(0)
+#define uip_clear_windowed()  do { } while(0)
+#define uip_windowed(conn)    0
+#endif
+
 
 /* uIP tests that can be made to determine in what state the current
    connection is, and what the application function should do. */
@@ -802,7 +840,11 @@ uip_udp_conn_t *uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callbac
  *
  * \hideinitializer
  */
+#ifdef UIP_CONN_HASH_SUPPORT
+#define uip_udp_remove(conn) uip_udp_bind(conn, 0)
+#else
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif
 
 /**
  * Bind a UDP connection to a local port.
@@ -814,7 +856,11 @@ uip_udp_conn_t *uip_udp_new(uip_ipaddr_t *ripaddr, u16_t rport, uip_conn_callbac
  *
  * \hideinitializer
  */
+#ifdef UIP_CONN_HASH_SUPPORT
+void uip_udp_bind(uip_udp_conn_t *conn, u16_t port);
+#else
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1249,6 +1295,15 @@ struct __uip_conn {
   u16_t timeout;       /** < The connection timeout timer */
 #endif
 
+#ifdef UIP_REXMIT_BUFFER_SUPPORT
+  u8_t rexmit;        /**< First retransmit buffer holding data in
+			 flight, if any. */
+#endif
+#ifdef UIP_TCP_WINDOW_SUPPORT
+  u8_t windowed;      /**< Several segments may be in flight. */
+  u16_t snd_wnd;      /**< Window last advertised by the peer. */
+#endif
+
   /** The application state. */
   uip_tcp_appstate_t appstate;
 
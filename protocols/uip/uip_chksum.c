@@ -0,0 +1,70 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "protocols/uip/uip_chksum.h"
+
+/* Word-at-a-time Internet checksum for host builds.
+
+   The words are summed up in memory order, eight bytes per iteration,
+   into a 64-bit accumulator.  Since uIP packets are below 64k, the
+   accumulator cannot overflow and all carries can be folded back in one
+   go at the end.  The one's complement sum is independent of the byte
+   order, so we just have to swap the final result into host order. */
+u16_t
+uip_arch_chksum(u16_t sum, const u8_t *data, u16_t len)
+{
+  uint64_t acc = htons(sum);
+
+  while(len >= 8) {
+    uint64_t w;
+    memcpy(&w, data, 8);
+    acc += (w & 0xffffffff) + (w >> 32);
+    data += 8;
+    len -= 8;
+  }
+
+  if(len >= 4) {
+    uint32_t w;
+    memcpy(&w, data, 4);
+    acc += w;
+    data += 4;
+    len -= 4;
+  }
+
+  if(len >= 2) {
+    u16_t w;
+    memcpy(&w, data, 2);
+    acc += w;
+    data += 2;
+    len -= 2;
+  }
+
+  if(len) {
+    u8_t last[2] = { data[0], 0 };
+    u16_t w;
+    memcpy(&w, last, 2);
+    acc += w;
+  }
+
+  while(acc >> 16)
+    acc = (acc & 0xffff) + (acc >> 16);
+
+  return htons((u16_t) acc);
+}
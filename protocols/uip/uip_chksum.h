@@ -0,0 +1,49 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ */
+
+#ifndef UIP_CHKSUM_H
+#define UIP_CHKSUM_H
+
+#include "protocols/uip/uip.h"
+
+#if UIP_ARCH_CHKSUM
+/* Add the big-endian 16-bit words at `data' to the one's complement sum
+   `sum'.  An odd trailing byte is padded with zero.  Both `sum' and the
+   result are in host byte order.  Provided by uip_chksum.c (host) or
+   uip_chksum_avr.S (AVR). */
+u16_t uip_arch_chksum(u16_t sum, const u8_t *data, u16_t len);
+#endif
+
+/* One's complement addition with end-around carry. */
+static inline u16_t
+uip_chksum_add(u16_t a, u16_t b)
+{
+  a += b;
+  return a + (a < b);
+}
+
+/* Return the checksum field `chksum' updated for a 16-bit word covered
+   by it changing from `old' to `new' (RFC 1624, eqn. 3:
+   HC' = ~(~HC + ~m + m')).  All values are taken as stored in the packet,
+   i.e. network byte order; the one's complement sum does not care about
+   the byte order as long as it is the same for all operands. */
+static inline u16_t
+uip_chksum_adjust(u16_t chksum, u16_t old, u16_t new)
+{
+  return ~uip_chksum_add(uip_chksum_add(~chksum, ~old), new);
+}
+
+#endif  /* UIP_CHKSUM_H */
@@ -24,6 +24,7 @@
 #ifdef ROUTER_SUPPORT
 
 #include "protocols/uip/uip.h"
+#include "protocols/uip/uip_chksum.h"
 #include "protocols/uip/uip_neighbor.h"
 
 #include "protocols/uip/ipv6.h"
@@ -139,11 +140,9 @@ router_input(uint8_t origin)
 
 #if !UIP_CONF_IPV6
       /* For IPv4 we must adjust the chksum */
-      if(BUF->ipchksum >= HTONS(0xffff - (1 << 8)))
-	BUF->ipchksum += HTONS(1 << 8) + 1;
-
-      else
-	BUF->ipchksum += HTONS(1 << 8);
+      BUF->ipchksum = uip_chksum_adjust(BUF->ipchksum,
+					HTONS((BUF->ttl + 1) << 8),
+					HTONS(BUF->ttl << 8));
 #endif
 
       /* For router_output_to uip_len must be set to the number of
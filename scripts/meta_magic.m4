@@ -41,14 +41,11 @@ divert(0)dnl
 
 #include <stdint.h>
 #include "core/debug.h"
+#include "core/periodic_stats.h"
 #include "services/freqcount/freqcount.h"
 
 #if ARCH == ARCH_HOST
-#include <sys/time.h>
-#include <sys/types.h>
-#include <unistd.h>
-#include "core/host/tap.h"
-#include "core/host/stdin.h"
+#include "core/host/loop.h"
 
 /* for C-c exit handler */
 #include <signal.h>
@@ -59,6 +56,9 @@ void ethersex_meta_exit (int signal);
 
 void dyndns_update(void);
 void periodic_process(void);
+#if ARCH == ARCH_HOST
+static uint16_t periodic_next_due(uint16_t counter);
+#endif
 volatile uint8_t newtick;
 
 divert(initearly_divert)dnl
@@ -171,43 +171,39 @@ define(`timer_divert_start', `divert(eval(timer_divert_base` + $1 * 2'))$2')
 define(`timer_divert_end', `divert(eval(timer_divert_base` + $1 * 2 + 1'))$2')
 define(`_divert_used', `ifelse(eval(`$1 > 'timer_divert_last), `1', `errprint(`timer_meta: Too big timer $1
 ')m4exit(1)')ifdef(`_divert_used_$1', `', `define(`_divert_used_$1', `1')
+divert(eval(timer_divert_base` + 'timer_divert_last` * 2 + 4'))dnl
+    n = $1 - counter % $1; if (n < due) due = n;
 timer_divert_start($1, `
 if (counter % $1 == 0) {
 ')dnl
 timer_divert_end($1, `}
 ')dnl
 ')')
-define(`timer', `pushdivert()_divert_used($1)timer_divert_start($1, `$2;
+define(`_timer_plain', `pushdivert()_divert_used($1)timer_divert_start($1, `$2;
 ')popdivert()')
+dnl timer(n, func) - every timer gets an index into the statistics
+define(`_stats_divert', `eval(timer_divert_base` + 'timer_divert_last` * 2 + 6')')
+define(`_stats_index', 0)
+define(`stripBrackets', `patsubst($*, `(.*)$')')
+define(`timer', `pushdivert()_divert_used($1)timer_divert_start($1, `PERIODIC_STATS_RUN('_stats_index`, $1, $2);
+')divert(_stats_divert)    "stripBrackets(`$2')\0"
+define(`_stats_index', incr(_stats_index))popdivert()')
 divert(timer_divert_base)
 void periodic_process(void)
 {
     static uint16_t counter = 0;
 #if ARCH == ARCH_HOST
-    {
-	fd_set fds;
-	struct timeval tv = { .tv_sec = 0, .tv_usec = 20000 };
-
-	FD_ZERO (&fds);
-#ifdef ECMD_PARSER_SUPPORT
-	FD_SET (0, &fds);
-#endif  /* ECMD_PARSER_SUPPORT */
-	FD_SET (tap_fd, &fds);
-	select (tap_fd + 1, &fds, NULL, NULL, &tv);
-
-#ifdef ECMD_PARSER_SUPPORT
-	if (FD_ISSET (0, &fds))
-	   stdin_read ();
-#endif  /* ECMD_PARSER_SUPPORT */
-
-	if (FD_ISSET (tap_fd, &fds))
-	   tap_read ();
-
+    /* Sleep until the next periodic block is due, serving I/O meanwhile.
+       Ticks without anything to do are skipped in one go. */
+    uint16_t ticks = host_loop_wait (periodic_next_due (counter));
+    if (ticks) {
+	counter += ticks - 1;
 #else
     if (newtick) {
         newtick=0;
 #endif
         counter++;
+        PERIODIC_STATS_TICK_START();
 #ifdef UIP_SUPPORT
         if (uip_buf_lock ()) {
 #ifdef RFM12_IP_SUPPORT
@@ -262,5 +258,29 @@ divert(eval(timer_divert_base`+'timer_divert_last` * 2 + 2'))
 #endif
   }
 }
+
+divert(eval(timer_divert_base`+'timer_divert_last` * 2 + 3'))
+#if ARCH == ARCH_HOST
+/* Number of ticks until counter reaches the next used divider. */
+static uint16_t
+periodic_next_due(uint16_t counter)
+{
+    uint16_t n, due = UINT16_MAX;
+divert(eval(timer_divert_base`+'timer_divert_last` * 2 + 5'))dnl
+    return due;
+}
+#endif  /* ARCH == ARCH_HOST */
+divert(_stats_divert)
+#ifdef PERIODIC_STATS_SUPPORT
+/* Names of the periodic functions and statistics of all of them. */
+const char periodic_stats_names[] PROGMEM =
 divert(-1)
-timer(timer_divert_last, `counter = 0')
+_timer_plain(timer_divert_last, `counter = 0')
+m4wrap(`divert(eval(_stats_divert` + 1'))dnl
+    "";
+
+const uint8_t periodic_stats_names_max = _stats_index;
+periodic_stats_t periodic_stats[_stats_index];
+const uint8_t periodic_stats_max = _stats_index;
+#endif /* PERIODIC_STATS_SUPPORT */
+divert(-1)')
@@ -103,7 +103,9 @@ define(`timer_divert_static_start', `eval(timer_divert` + 1')')dnl
 define(`timer_divert_static_end', `eval(timer_divert_static_start` + 1')')dnl
 define(`timer_divert_static_control_start', `eval(timer_divert_static_end` + 1')')dnl
 define(`timer_divert_static_control_end', `eval(timer_divert_static_control_start` + 1')')dnl
-define(`implementation_start_divert', `eval(timer_divert_static_control_end` + 1')')dnl
+define(`timer_divert_static_names_start', `eval(timer_divert_static_control_end` + 1')')dnl
+define(`timer_divert_static_names_end', `eval(timer_divert_static_names_start` + 1')')dnl
+define(`implementation_start_divert', `eval(timer_divert_static_names_end` + 1')')dnl
 define(`initearly_divert', `eval(implementation_start_divert` + 1')')dnl
 define(`init_divert', `eval(initearly_divert` + 1')')dnl
 define(`net_init_divert', `eval(init_divert` + 1')')dnl
@@ -170,7 +172,10 @@ format(`    { %s, %d }, /* static timer */
 ', `$1', `$3')popdivert()dnl
 pushdivert()divert(timer_divert_static_control_start)dnl
 format(`    { %d, TIMER_RUNNABLE }, /* %s() static timer control */
-', `$2', `$1')popdivert()')
+', `$2', `$1')popdivert()dnl
+pushdivert()divert(timer_divert_static_names_start)dnl
+format(`    "%s\0"
+', `$1')popdivert()')
 
 dnl statictimer()
 dnl sort and distribute static timers
@@ -238,13 +243,10 @@ dnl *** Start of meta.c contents ***
 
 #include <stdint.h>
 #include "core/debug.h"
+#include "core/periodic_stats.h"
 
 #if ARCH == ARCH_HOST
-#include <sys/time.h>
-#include <sys/types.h>
-#include <unistd.h>
-#include "core/host/tap.h"
-#include "core/host/stdin.h"
+#include "core/host/loop.h"
 
 /* for C-c exit handler */
 #include <signal.h>
@@ -279,7 +281,7 @@ divert(timer_divert_static_end)dnl
  * Static millitimers control block in RAM.
  */
 static_timer_cb_t scheduler_static_timers_control[] = {
- /* { uint16_t delay, uint8_t state } */
+ /* { uint16_t delay, uint8_t state, uint8_t next } */
 divert(timer_divert_static_control_start)dnl
 divert(timer_divert_static_control_end)dnl
 };
@@ -289,6 +291,27 @@ divert(timer_divert_static_control_end)dnl
  */
 const uint8_t scheduler_static_timer_max = sizeof(scheduler_static_timers) / sizeof(scheduler_static_timers[0]);
 
+#ifdef PERIODIC_STATS_SUPPORT
+/*
+ * Names of the static millitimers and statistics of all timers.
+ */
+const char periodic_stats_names[] PROGMEM =
+divert(timer_divert_static_names_start)dnl
+divert(timer_divert_static_names_end)dnl
+    "";
+
+const uint8_t periodic_stats_names_max = sizeof(scheduler_static_timers) / sizeof(scheduler_static_timers[0]);
+
+#ifdef SCHEDULER_DYNAMIC_SUPPORT
+periodic_stats_t periodic_stats[sizeof(scheduler_static_timers) / sizeof(scheduler_static_timers[0])
+                                + CONF_SCHEDULER_NUM_DYNAMIC_TIMERS];
+#else
+periodic_stats_t periodic_stats[sizeof(scheduler_static_timers) / sizeof(scheduler_static_timers[0])];
+#endif
+
+const uint8_t periodic_stats_max = sizeof(periodic_stats) / sizeof(periodic_stats[0]);
+#endif /* PERIODIC_STATS_SUPPORT */
+
 dnl
 dnl functions follow
 dnl
@@ -397,25 +420,15 @@ divert(postamble_divert)
 void periodic_process(void)
 {
 #if ARCH == ARCH_HOST
-  {
-    fd_set fds;
-    struct timeval tv = { .tv_sec = 0, .tv_usec = 20000 };
-
-    FD_ZERO (&fds);
-#ifdef ECMD_PARSER_SUPPORT
-    FD_SET (0, &fds);
-#endif  /* ECMD_PARSER_SUPPORT */
-    FD_SET (tap_fd, &fds);
-    select (tap_fd + 1, &fds, NULL, NULL, &tv);
-
-#ifdef ECMD_PARSER_SUPPORT
-    if (FD_ISSET (0, &fds))
-      stdin_read ();
-#endif  /* ECMD_PARSER_SUPPORT */
-
-    if (FD_ISSET (tap_fd, &fds))
-      tap_read ();
-
+    /* Sleep until the first queued timer is due, serving I/O meanwhile.
+       There is no milliticks ISR on the host, so the milliticks slept
+       are handed to the scheduler here. */
+    uint16_t ticks = (scheduler_next_due () + HOST_LOOP_MTICKS - 1)
+                     / HOST_LOOP_MTICKS;
+    ticks = host_loop_wait (ticks ? ticks : 1);
+    if (ticks) {
+      uint32_t elapsed = scheduler_elapsed + (uint32_t) ticks * HOST_LOOP_MTICKS;
+      scheduler_elapsed = elapsed < UINT16_MAX ? elapsed : UINT16_MAX;
 #else /* not ARCH_HOST */
     if (newtick) {
       newtick=0;
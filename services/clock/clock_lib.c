@@ -122,27 +122,24 @@ clock_datetime(clock_datetime_t * d, timestamp_t t)
   /* day of week */
   d->dow = (days + EPOCH_DOW) % 7;
 
-  /* year: For every year from EPOCH_YEAR upto now, check for a leap year
-   * (for details on leap years see http://en.wikipedia.org/wiki/Leap_year) */
-  uint16_t year = EPOCH_YEAR;
-
-  /* year, check if we have enough days left to fill a year */
-  while (days >= 365)
-  {
-    if (IS_LEAP_YEAR(year))
-    {
-      /* special case: leap year is not over after 365 days... */
-      if (days == 365)
-        break;
-
-      /* default case: leap years have one more day */
-      days -= 1;
-    }
-
-    /* normal years have 365 days */
-    days -= 365;
-    year++;
-  }
+  /* year: Up to 2106 every fourth year is a leap year, except 2100 (for
+   * details on leap years see http://en.wikipedia.org/wiki/Leap_year).
+   * Count cycles of four years from 1969 on, so the leap year comes last,
+   * and pretend 2100 had a 29th of february. */
+  uint8_t after_2100_02_28 = days >= 47541;
+  uint16_t cycle = days + 365 + after_2100_02_28;
+  uint16_t year = EPOCH_YEAR - 1 + cycle / 1461 * 4;
+  cycle %= 1461;
+
+  uint8_t years = cycle / 365;
+  /* special case: leap year is not over after 365 days... */
+  if (years == 4)
+    years = 3;
+
+  year += years;
+  days = cycle - years * 365;
+  if (after_2100_02_28 && year == 2100)
+    days--;
 
   d->year = year - 1900;
 
@@ -39,10 +39,20 @@
 #define CRON_FILENAME "crn.t"
 #endif
 
+/* Give up searching the next fire time after this many steps, the job is
+ * checked again at the time the search stopped. */
+#define CRON_SEARCH_STEPS 64
+
 uint32_t last_check;
 struct cron_event_linkedlist *head;
 struct cron_event_linkedlist *tail;
 
+/* Min-heap of all jobs, the one to fire first at queue[0]. */
+static struct cron_event_linkedlist **queue;
+static uint16_t queue_len;
+static uint16_t queue_size;
+static uint16_t next_order;
+
 #ifdef CRON_PERSIST_SUPPORT
 void
 cron_load()
@@ -257,6 +267,8 @@ cron_init(void)
   // very important: set the linked lists head and tail to zero
   head = 0;
   tail = 0;
+  queue_len = 0;
+  next_order = 0;
 
   // do we want to have some test entries?
 #ifdef CRON_SUPPORT_TEST
@@ -275,6 +287,230 @@ cron_init(void)
 }
 
 
+/* Offset of the local time to UTC at timestamp t, including DST. */
+static int32_t
+cron_utc_offset(uint32_t t)
+{
+  clock_datetime_t ld;
+  clock_localtime(&ld, t);
+  return clock_mktime(&ld, 0) - t;
+}
+
+/* Seconds from date c to the next value of cron field f that may match,
+ * or to the start of the next larger unit if there is none.  If c is the
+ * calendar of the absolute values, minutes and hours before those are
+ * skipped as well. */
+static uint32_t
+cron_skip(cron_conditions_t * cond, uint8_t f, clock_datetime_t * c,
+          uint8_t absolute)
+{
+  uint16_t year = c->year + 1900;
+  uint8_t days = clock_month_days(c->month);
+  if (c->month == 2 && IS_LEAP_YEAR(year))
+    days++;
+
+  const uint8_t max[4] = { 59, 23, days, 12 };
+  const uint32_t unit[4] = { 60, 3600, 86400, days * 86400UL };
+  /* seconds passed in the current minute, hour, day and month */
+  uint32_t passed[4];
+  passed[0] = c->sec;
+  passed[1] = passed[0] + c->min * 60;
+  passed[2] = passed[1] + c->hour * 3600UL;
+  passed[3] = passed[2] + (c->day - 1) * 86400UL;
+
+  uint32_t skip;
+  uint8_t start_over = 2;       /* number of fields starting over */
+  if (f < 4)
+  {
+    int8_t x = cond->fields[f];
+    uint8_t cur = c->cron_fields[f];
+    uint8_t v = x;
+    if (x < 0)
+    {
+      uint8_t step = -x;
+      v = cur - cur % step + step;
+    }
+
+    if (f < 3 && v > cur && v <= max[f])
+    {
+      skip = (v - cur) * unit[f] - passed[f];
+      start_over = f;
+    }
+    else
+    {
+      /* the month starts over with the next one */
+      if (f < 3)
+        f++;
+      skip = unit[f] - passed[f];
+      start_over = f;
+    }
+  }
+  else                          /* next day, day of the week */
+    skip = unit[2] - passed[2];
+
+  if (absolute)
+    for (uint8_t l = 0; l < start_over && l < 2; l++)
+    {
+      int8_t x = cond->fields[l];
+      if (x > 0 && x <= max[l])
+        skip += x * unit[l];
+    }
+
+  return skip;
+}
+
+/* First minute at or after t the conditions match, see cron_check_event.
+ * Skips whole minutes, hours, days or months that cannot match. */
+static uint32_t
+cron_next_fire(cron_conditions_t * cond, uint8_t use_utc, uint32_t t)
+{
+  clock_datetime_t d, ld;
+  clock_datetime_t *cd = use_utc ? &d : &ld;
+  int32_t offset = 0;
+  uint32_t skipped_utc = 0;
+  uint8_t skipped_local = 0;
+
+  t += 59;
+  t -= t % 60;
+
+  for (uint8_t i = 0; i < CRON_SEARCH_STEPS; i++)
+  {
+    clock_datetime(&d, t);
+    if (!use_utc)
+    {
+      clock_localtime(&ld, t);
+
+      /* A skip in local time ends too late, if the clock has been put
+       * forward in between.  Go back to the local time aimed at, if it
+       * exists. */
+      int32_t jump = clock_mktime(&ld, 0) - t - offset;
+      offset += jump;
+      if (skipped_local && jump > 0 && cron_utc_offset(t - jump) == offset)
+      {
+        uint32_t aimed = t - jump > skipped_utc ? t - jump : skipped_utc;
+        skipped_local = 0;
+        if (aimed < t)
+        {
+          t = aimed;
+          continue;
+        }
+      }
+    }
+
+    if (cron_check_event(cond, use_utc, &d, &ld))
+      return t;
+
+    /* Absolute values are checked against the local time, steps against
+     * UTC.  Every skip leaves out only times that do not match, so the
+     * largest one is taken. */
+    uint32_t skip_utc = 0, skip_local = 0;
+    for (uint8_t f = 0; f <= 4; f++)
+    {
+      clock_datetime_t *c = cd;
+      if (f < 4)
+      {
+        int8_t x = cond->fields[f];
+        if (x == -1)
+          continue;
+
+        uint8_t cur = cd->cron_fields[f];
+        uint8_t step = -x;
+        if (x < 0)
+          c = &d;
+        if (x >= 0 ? x == cur : d.cron_fields[f] % step == 0)
+          continue;
+      }
+      else if (cond->daysofweek & _BV(cd->dow))
+        continue;
+
+      uint32_t skip = cron_skip(cond, f, c, c == cd);
+      if (c == &d && skip > skip_utc)
+        skip_utc = skip;
+      if (c != &d && skip > skip_local)
+        skip_local = skip;
+    }
+
+    skipped_utc = t + skip_utc;
+    skipped_local = skip_local > skip_utc;
+    t += skipped_local ? skip_local : skip_utc;
+  }
+
+  return t;
+}
+
+static uint8_t
+cron_before(struct cron_event_linkedlist *a, struct cron_event_linkedlist *b)
+{
+  return a->next_fire < b->next_fire
+    || (a->next_fire == b->next_fire && a->order < b->order);
+}
+
+/* Move the job at index i up or down, until the heap is in order again. */
+static void
+cron_queue_fix(uint16_t i)
+{
+  struct cron_event_linkedlist *job = queue[i];
+
+  while (i > 0 && cron_before(job, queue[(i - 1) / 2]))
+  {
+    queue[i] = queue[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+
+  for (;;)
+  {
+    uint16_t child = 2 * i + 1;
+    if (child >= queue_len)
+      break;
+    if (child + 1 < queue_len && cron_before(queue[child + 1], queue[child]))
+      child++;
+    if (!cron_before(queue[child], job))
+      break;
+
+    queue[i] = queue[child];
+    i = child;
+  }
+
+  queue[i] = job;
+}
+
+static void
+cron_queue_remove(struct cron_event_linkedlist *job)
+{
+  for (uint16_t i = 0; i < queue_len; i++)
+  {
+    if (queue[i] != job)
+      continue;
+
+    queue[i] = queue[--queue_len];
+    if (i < queue_len)
+      cron_queue_fix(i);
+    return;
+  }
+}
+
+static void
+cron_queue_push(struct cron_event_linkedlist *job)
+{
+  queue[queue_len++] = job;
+  cron_queue_fix(queue_len - 1);
+}
+
+/* Compute the next fire time from timestamp t on and queue the job. */
+static void
+cron_schedule(struct cron_event_linkedlist *job, uint32_t t)
+{
+  job->next_fire = cron_next_fire(&job->event.cond, job->event.use_utc, t);
+  cron_queue_push(job);
+}
+
+void
+cron_reschedule(struct cron_event_linkedlist *job)
+{
+  cron_queue_remove(job);
+  cron_schedule(job, last_check + 60);
+}
+
 int16_t
 cron_jobinsert_callback(int8_t minute, int8_t hour, int8_t day, int8_t month,
                         int8_t daysofweek, uint8_t repeat, int8_t position,
@@ -355,9 +591,27 @@ cron_jobinsert_ecmd(int8_t minute, int8_t hour, int8_t day, int8_t month,
   return cron_insert(newone, position);
 }
 
-uint8_t
+int16_t
 cron_insert(struct cron_event_linkedlist * newone, int8_t position)
 {
+  uint8_t ss = 0;
+
+  // make room in the queue
+  if (queue_len == queue_size)
+  {
+    void *grown = realloc(queue, (queue_size + 4) * sizeof(*queue));
+    if (!grown)
+    {
+#ifdef DEBUG_CRON
+      debug_printf("cron: not enough ram!\n");
+#endif
+      free(newone);
+      return -1;
+    }
+    queue = grown;
+    queue_size += 4;
+  }
+
   // add to linked list
   if (!head)
   {                             // special case: empty list (ignore position)
@@ -368,12 +622,9 @@ cron_insert(struct cron_event_linkedlist * newone, int8_t position)
 #ifdef DEBUG_CRON
     debug_printf("cron: insert head\n");
 #endif
-    return 0;
   }
-
-  if (position > 0)
+  else if (position > 0)
   {
-    uint8_t ss = 0;
     struct cron_event_linkedlist *job = head;
 
     // jump to position
@@ -385,6 +636,8 @@ cron_insert(struct cron_event_linkedlist * newone, int8_t position)
     }
 
     newone->prev = job->prev;
+    if (job->prev)
+      job->prev->next = newone;
     job->prev = newone;
     newone->next = job;
     if (job == head)
@@ -396,18 +649,34 @@ cron_insert(struct cron_event_linkedlist * newone, int8_t position)
       debug_printf("cron: insert at %i ecmd %s\n", ss,
                    newone->event.ecmddata);
 #endif
-    return ss;
   }
-
-  // insert as last element
-  newone->next = 0;
-  newone->prev = tail;
-  tail->next = newone;
-  tail = newone;
+  else
+  {
+    // insert as last element
+    newone->next = 0;
+    newone->prev = tail;
+    tail->next = newone;
+    tail = newone;
 #ifdef DEBUG_CRON
-  debug_printf("cron: append\n");
+    debug_printf("cron: append\n");
 #endif
-  return cron_jobs() - 1;
+    ss = cron_jobs() - 1;
+  }
+
+  // number the jobs again, if there is no order left for the new one
+  if (newone == tail && next_order < UINT16_MAX)
+    newone->order = next_order++;
+  else
+  {
+    struct cron_event_linkedlist *job;
+    next_order = 0;
+    for (job = head; job; job = job->next)
+      job->order = next_order++;
+  }
+
+  // jobs are checked from the next minute on
+  cron_schedule(newone, last_check + 60);
+  return ss;
 }
 
 void
@@ -429,6 +698,8 @@ cron_jobrm(struct cron_event_linkedlist *job)
   if (job->next)
     job->next->prev = job->prev;
 
+  cron_queue_remove(job);
+
   // free the current element
   free(job);
 
@@ -520,82 +791,84 @@ cron_execute(struct cron_event_linkedlist *exec)
 }
 
 #ifdef CRON_ANACRON_SUPPORT
-uint8_t
-cron_anacron(uint32_t starttime, uint32_t endtime)
+static uint8_t
+cron_match(struct cron_event_linkedlist *job, uint32_t timestamp)
 {
   clock_datetime_t d, ld;
-  struct cron_event_linkedlist *curr;
-
-  /* count anacron jobs and set pending */
-  uint8_t count = 0;
-  for (curr = head; curr != 0; curr = curr->next)
-  {
-    if ((curr->event.anacron_pending = curr->event.anacron))
-      count++;
-  }
-#ifdef DEBUG_CRON
-  debug_printf("cron: %i anacron jobs found\n", count);
-#endif
-  if (count == 0)
-    return 0;
+  clock_datetime(&d, timestamp);
+  clock_localtime(&ld, timestamp);
+  return cron_check_event(&job->event.cond, job->event.use_utc, &d, &ld);
+}
 
-  /* alloc space for anacron list */
-  struct cron_event_linkedlist **tab =
-    __builtin_alloca(count * sizeof(struct cron_event_linkedlist *));
-  if (!tab)
-  {
-#ifdef DEBUG_CRON
-    debug_printf("cron: not enough ram!\n");
-#endif
-    return 0;
-  }
+void
+cron_anacron(uint32_t starttime, uint32_t endtime)
+{
+  struct cron_event_linkedlist *curr, *exec;
 
   /* limit range */
   if ((endtime - starttime) > CRON_ANACRON_MAXAGE)
     starttime = endtime - CRON_ANACRON_MAXAGE;
 
-  /* prepare anacron tab (reverse time order!!) */
-  uint8_t pos = 0;
-  uint32_t timestamp;
-  for (timestamp = endtime; timestamp > starttime && pos < count;
-       timestamp -= 60)
+  /* first minute that has not been checked */
+  starttime += 60 - starttime % 60;
+
+  /* A job is pending if it should have fired in between.  Its next fire
+   * time is the first one since the last check, unless that is too old. */
+  for (curr = head; curr != 0; curr = curr->next)
   {
-    clock_datetime(&d, timestamp);
-    clock_localtime(&ld, timestamp);
+    curr->event.anacron_pending = 0;
+    if (!curr->event.anacron)
+      continue;
 
-    for (curr = head; curr != 0; curr = curr->next)
-    {
-      if (curr->event.anacron_pending &&
-          cron_check_event(&curr->event.cond, curr->event.use_utc, &d, &ld))
-      {
-        curr->event.anacron_pending = 0;
-        tab[pos++] = curr;
-      }
-    }
+    uint32_t fire = curr->next_fire;
+    if (fire < starttime)
+      fire = cron_next_fire(&curr->event.cond, curr->event.use_utc,
+                            starttime);
+    while (fire <= endtime && !cron_match(curr, fire))
+      fire = cron_next_fire(&curr->event.cond, curr->event.use_utc,
+                            fire + 60);
+
+    curr->event.anacron_pending = fire <= endtime;
+
+    /* runs at most once, even if the current minute matches */
+    curr->next_fire = cron_next_fire(&curr->event.cond, curr->event.use_utc,
+                                     endtime + 60);
   }
-#ifdef DEBUG_CRON
-  debug_printf("cron: %i pending anacron jobs\n", pos);
-#endif
+
+  /* queue all jobs again */
+  queue_len = 0;
+  for (curr = head; curr != 0; curr = curr->next)
+    cron_queue_push(curr);
 
   /* process jobs */
-  while (pos)
-    cron_execute(tab[--pos]);
+  curr = head;
+  while (curr)
+  {
+    exec = curr;
+    curr = curr->next;
 
-  return 1;
+    if (exec->event.anacron_pending)
+    {
+      exec->event.anacron_pending = 0;
+      cron_execute(exec);
+    }
+  }
 }
 #endif
 
 void
 cron_periodic(void)
 {
-  clock_datetime_t d, ld;
   uint32_t timestamp = clock_get_time();
+  struct cron_event_linkedlist *job;
 
-  /* fix last_check */
+  /* fix last_check, the fire times lie in the future */
   if (timestamp < last_check)
   {
-    clock_datetime(&d, timestamp);
-    last_check = timestamp - d.sec;
+    last_check = timestamp - timestamp % 60;
+    queue_len = 0;
+    for (job = head; job; job = job->next)
+      cron_schedule(job, last_check + 60);
     return;
   }
 
@@ -603,39 +876,46 @@ cron_periodic(void)
   if (!head || (timestamp - last_check) < 60)
     return;
 
-  /* get time and date from unix timestamp */
-  clock_datetime(&d, timestamp);
-  clock_localtime(&ld, timestamp);
-
   /* truncate secs */
-  timestamp -= d.sec;
+  timestamp -= timestamp % 60;
 
 #ifdef CRON_ANACRON_SUPPORT
-  uint8_t skip_anacron = 0;
   if ((timestamp - last_check) > 60)
-    skip_anacron = cron_anacron(last_check, timestamp);
+    cron_anacron(last_check, timestamp);
 #endif
 
-  /* check every event for a match */
-  struct cron_event_linkedlist *current = head;
-  struct cron_event_linkedlist *exec;
-  while (current)
+  /* save the actual timestamp, new jobs start with the next minute */
+  last_check = timestamp;
+
+  /* nothing to do until the first job fires */
+  if (!queue_len || queue[0]->next_fire > timestamp)
+    return;
+
+  /* get time and date from unix timestamp */
+  clock_datetime_t d, ld;
+  clock_datetime(&d, timestamp);
+  clock_localtime(&ld, timestamp);
+
+  /* Jobs firing at the same time come in crontab order.  Runs missed
+   * while the clock was off are dropped, the job may still match the
+   * current minute. */
+  while (queue_len && queue[0]->next_fire <= timestamp)
   {
-    /* backup current cronjob and advance current */
-    exec = current;
-    current = current->next;
+    job = queue[0];
+    cron_queue_remove(job);
 
-#ifdef CRON_ANACRON_SUPPORT
-    if (skip_anacron && exec->event.anacron)
+    if (job->next_fire < timestamp)
+    {
+      cron_schedule(job, timestamp);
       continue;
-#endif
-    /* if it matches all conditions , execute the handler function */
-    if (cron_check_event(&exec->event.cond, exec->event.use_utc, &d, &ld))
-      cron_execute(exec);
-  }
+    }
 
-  /* save the actual timestamp */
-  last_check = timestamp;
+    cron_schedule(job, timestamp + 60);
+
+    /* if the search did not stop early, it matches all conditions */
+    if (cron_check_event(&job->event.cond, job->event.use_utc, &d, &ld))
+      cron_execute(job);
+  }
 }
 
 /*
@@ -78,6 +78,10 @@ struct cron_event_linkedlist
   // last entry's next is NULL, heads prev is NULL
   struct cron_event_linkedlist *next;
   struct cron_event_linkedlist *prev;
+  // time the job fires next, jobs are queued by next_fire and order
+  uint32_t next_fire;
+  // crontab position, for jobs that fire at the same time
+  uint16_t order;
   struct cron_event event;
 };
 
@@ -136,13 +140,16 @@ int16_t cron_save();
  * @brief Insert cron job to the linked list.
  * @param newone The new cron job structure (malloc'ed memory!)
  * @param position Where to insert the new job
- * @return position where job is inserted
+ * @return position where job is inserted, -1 in case of error (the job is freed)
  */
-uint8_t cron_insert(struct cron_event_linkedlist *newone, int8_t position);
+int16_t cron_insert(struct cron_event_linkedlist *newone, int8_t position);
 
 /** remove the job from the linked list */
 void cron_jobrm(struct cron_event_linkedlist *job);
 
+/** compute the next fire time of the job again, e.g. after changing use_utc */
+void cron_reschedule(struct cron_event_linkedlist *job);
+
 /** count jobs */
 uint8_t cron_jobs();
 
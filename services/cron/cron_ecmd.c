@@ -203,6 +203,7 @@ parse_cmd_cron_utc(char *cmd, char *output, uint16_t len)
   if (ret >= 2)
   {
     job->use_utc = state;
+    cron_reschedule(jobll);
     return ECMD_FINAL_OK;
   }
 
@@ -27,19 +27,128 @@
 #define READ_AHEAD_LEN 2
 #endif
 
+/* Modules that can read at an offset copy straight into the packet,
+   the others have to seek for retransmissions. */
+#ifdef VFS_TEENSY
+#define httpd_vfs_pread() 1
+#define httpd_vfs_seekable() 1
+#else
+#define httpd_vfs_pread() VFS_HAVE_FUNC (STATE->u.vfs.fd, pread)
+#define httpd_vfs_seekable() \
+    (httpd_vfs_pread () || VFS_HAVE_FUNC (STATE->u.vfs.fd, fseek))
+#endif
+
+#ifdef HTTPD_ETAG_SUPPORT
+static void
+httpd_handle_vfs_paste_cache (uint32_t etag)
+{
+    if (etag)
+	PASTE_PF (PSTR ("ETag: \"%08lx\"\n"), (unsigned long) etag);
+
+    unsigned long max_age = STATE->u.vfs.page
+	? HTTPD_MAXAGE_PAGES : HTTPD_MAXAGE_FILES;
+    if (max_age)
+	PASTE_PF (PSTR ("Cache-Control: max-age=%lu\n"), max_age);
+    else
+	PASTE_P (PSTR ("Cache-Control: no-cache\n"));
+}
+#endif	/* HTTPD_ETAG_SUPPORT */
+
 static void
 httpd_handle_vfs_send_header (void)
 {
     PASTE_RESET ();
-    PASTE_P (httpd_header_200);
+
+#ifdef HTTPD_ETAG_SUPPORT
+    uint32_t etag = vfs_etag (STATE->u.vfs.fd);
+    if (etag && STATE->u.vfs.if_none_match && STATE->u.vfs.etag == etag) {
+	/* The client's copy is still good, send the headers only. */
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	PASTE_P (STATE->keepalive ? httpd_header_304_keepalive
+		 : httpd_header_304);
+#else
+	PASTE_P (httpd_header_304);
+#endif
+	httpd_handle_vfs_paste_cache (etag);
+	PASTE_P (httpd_header_end);
+	PASTE_SEND ();
+	STATE->eof = 1;
+	return;
+    }
+#endif	/* HTTPD_ETAG_SUPPORT */
 
     vfs_size_t len = vfs_size (STATE->u.vfs.fd);
-    if (len > 0) {
-	/* send content-length header */
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* Without a length only closing tells where the file ends. */
+    if (len == 0)
+	STATE->keepalive = 0;
+#endif
+
+#ifdef HTTPD_RANGE_SUPPORT
+    if (len == 0 || !httpd_vfs_seekable ())
+	STATE->u.vfs.range = 0;
+
+    if (STATE->u.vfs.range) {
+	/* Resolve the range against the file size, once; this might be
+	   a rexmit of the header. */
+	if (STATE->u.vfs.range_suffix) {
+	    STATE->u.vfs.range_start = STATE->u.vfs.range_start < len
+		? len - STATE->u.vfs.range_start : 0;
+	    STATE->u.vfs.range_end = len;
+	    STATE->u.vfs.range_suffix = 0;
+	}
+	if (STATE->u.vfs.range_end == 0 || STATE->u.vfs.range_end > len)
+	    STATE->u.vfs.range_end = len;
+
+	if (STATE->u.vfs.range_start >= STATE->u.vfs.range_end) {
+	    PASTE_P (httpd_header_416);
+	    PASTE_PF (PSTR ("Content-Range: bytes */%lu\n\n"),
+		      (unsigned long) len);
+	    PASTE_SEND ();
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	    STATE->keepalive = 0;
+#endif
+	    STATE->eof = 1;
+	    return;
+	}
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	PASTE_P (STATE->keepalive ? httpd_header_206_keepalive
+		 : httpd_header_206);
+#else
+	PASTE_P (httpd_header_206);
+#endif
 	PASTE_P (httpd_header_length);
-	PASTE_LEN (len);
+	PASTE_LEN (STATE->u.vfs.range_end - STATE->u.vfs.range_start);
+	PASTE_PF (PSTR ("Content-Range: bytes %lu-%lu/%lu\n"),
+		  (unsigned long) STATE->u.vfs.range_start,
+		  (unsigned long) STATE->u.vfs.range_end - 1,
+		  (unsigned long) len);
+    }
+    else
+#endif	/* HTTPD_RANGE_SUPPORT */
+    {
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	PASTE_P (STATE->keepalive ? httpd_header_200_keepalive
+		 : httpd_header_200);
+#else
+	PASTE_P (httpd_header_200);
+#endif
+	if (len > 0) {
+	    /* send content-length header */
+	    PASTE_P (httpd_header_length);
+	    PASTE_LEN (len);
+#ifdef HTTPD_RANGE_SUPPORT
+	    if (httpd_vfs_seekable ())
+		PASTE_P (httpd_header_ranges);
+#endif
+	}
     }
 
+#ifdef HTTPD_ETAG_SUPPORT
+    httpd_handle_vfs_paste_cache (etag);
+#endif
+
     /* Check whether the file is gzip compressed. */
     unsigned char buf[READ_AHEAD_LEN];
 #ifndef VFS_TEENSY
@@ -81,11 +190,72 @@ no_gzip:
 }
 
 
+/* Limit a read of WANT bytes at POS to the requested range. */
+static vfs_size_t
+httpd_handle_vfs_limit (vfs_size_t pos, vfs_size_t want)
+{
+#ifdef HTTPD_RANGE_SUPPORT
+    if (STATE->u.vfs.range && want > STATE->u.vfs.range_end - pos)
+	want = STATE->u.vfs.range_end - pos;
+#endif
+    return want;
+}
+
+/* The header is out, the body starts at the beginning of the range. */
+static void
+httpd_handle_vfs_start_body (void)
+{
+    vfs_size_t start = 0;
+#ifdef HTTPD_RANGE_SUPPORT
+    if (STATE->u.vfs.range && !STATE->eof) {
+	start = STATE->u.vfs.range_start;
+	if (!httpd_vfs_pread ())
+	    vfs_fseek (STATE->u.vfs.fd, start, SEEK_SET);
+    }
+#endif
+    STATE->header_acked = 1;
+    STATE->u.vfs.acked = start;
+    STATE->u.vfs.sent = start;
+}
+
 static void
 httpd_handle_vfs_send_body (void)
 {
-    vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.acked, SEEK_SET);
-    vfs_size_t len = vfs_read (STATE->u.vfs.fd, uip_appdata, uip_mss ());
+    if (uip_windowed (uip_conn)) {
+	/* uIP keeps what is in flight, we just append to the stream. */
+	vfs_size_t mss = uip_mss ();
+	if (mss == 0)
+	    return;		/* Window full */
+
+	vfs_size_t want = httpd_handle_vfs_limit (STATE->u.vfs.sent, mss);
+	vfs_size_t len;
+	if (httpd_vfs_pread ())
+	    len = vfs_pread (STATE->u.vfs.fd, uip_appdata, want,
+			     STATE->u.vfs.sent);
+	else
+	    len = vfs_read (STATE->u.vfs.fd, uip_appdata, want);
+	STATE->u.vfs.sent += len;
+	if (len < mss)		/* Short read or end of range -> EOF */
+	    STATE->eof = 1;
+	if (len > 0)
+	    uip_send (uip_appdata, len);
+	else if (!uip_outstanding (uip_conn))
+	    httpd_done ();
+	return;
+    }
+
+    vfs_size_t want = httpd_handle_vfs_limit (STATE->u.vfs.acked, uip_mss ());
+    vfs_size_t len;
+    if (httpd_vfs_pread ())
+	len = vfs_pread (STATE->u.vfs.fd, uip_appdata, want,
+			 STATE->u.vfs.acked);
+    else {
+	/* After an ACK the file position already is where the next chunk
+	   starts, only retransmissions have to go back. */
+	if (!uip_acked ())
+	    vfs_fseek (STATE->u.vfs.fd, STATE->u.vfs.acked, SEEK_SET);
+	len = vfs_read (STATE->u.vfs.fd, uip_appdata, want);
+    }
 
     if (len <= 0) {
 	uip_abort ();
@@ -93,7 +263,9 @@ httpd_handle_vfs_send_body (void)
 	return;
     }
 
-    if (len < uip_mss ())	/* Short read -> EOF */
+    /* Short read or end of range -> EOF */
+    if (len < uip_mss ()
+	|| httpd_handle_vfs_limit (STATE->u.vfs.acked + len, 1) == 0)
 	STATE->eof = 1;
 
     STATE->u.vfs.sent = STATE->u.vfs.acked + len;
@@ -107,16 +279,39 @@ httpd_handle_vfs (void)
 	if (STATE->header_acked)
 	    STATE->u.vfs.acked = STATE->u.vfs.sent;
 	else {
-	    STATE->header_acked = 1;
-	    STATE->u.vfs.acked = 0;
+	    httpd_handle_vfs_start_body ();
+	    /* Nothing in flight now, let the body stream with several
+	       segments outstanding. */
+	    uip_set_windowed ();
 	}
     }
 
-    if (!STATE->header_acked)
+    if (!STATE->header_acked) {
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+	/* Nothing is outstanding between two requests, don't wait for the
+	   (possibly delayed) ACK of the header before sending the body. */
+	if (STATE->requests > 1 && !uip_outstanding (uip_conn))
+	    uip_set_windowed ();
+#endif
+	if (uip_windowed (uip_conn)) {
+	    if (uip_mss () == 0)
+		return;		/* Window full */
+	    httpd_handle_vfs_send_header ();
+	    if (uip_slen <= uip_mss ()) {
+		httpd_handle_vfs_start_body ();
+		return;
+	    }
+	    /* uip_send() would crop the header to the window room, send it
+	       on its own and start the body once it has been acked. */
+	    uip_clear_windowed ();
+	}
 	httpd_handle_vfs_send_header ();
+    }
 
-    else if (STATE->eof && !uip_rexmit())
-	uip_close ();
+    else if (STATE->eof && !uip_rexmit()) {
+	if (!uip_outstanding (uip_conn))
+	    httpd_done ();
+    }
 
     else
 	httpd_handle_vfs_send_body ();
@@ -28,6 +28,36 @@ const char PROGMEM httpd_header_200[] =
 "Connection: close\n";
 
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+const char PROGMEM httpd_header_200_keepalive[] =
+"HTTP/1.1 200 OK\n"
+"Connection: keep-alive\n";
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+
+#ifdef HTTPD_RANGE_SUPPORT
+const char PROGMEM httpd_header_206[] =
+"HTTP/1.1 206 Partial Content\n"
+"Connection: close\n";
+
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+const char PROGMEM httpd_header_206_keepalive[] =
+"HTTP/1.1 206 Partial Content\n"
+"Connection: keep-alive\n";
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+
+
+const char PROGMEM httpd_header_416[] =
+"HTTP/1.1 416 Range Not Satisfiable\n"
+"Connection: close\n";
+
+
+const char PROGMEM httpd_header_ranges[] =
+"Accept-Ranges: bytes\n";
+#endif	/* HTTPD_RANGE_SUPPORT */
+
+
 const char PROGMEM httpd_header_ct_css[] =
 "Content-Type: text/css; charset=utf-8\n\n";
 
@@ -52,6 +82,19 @@ const char PROGMEM httpd_header_ecmd[] =
 #endif	/* ECMD_PARSER_SUPPORT */
 
 
+#ifdef HTTPD_ETAG_SUPPORT
+const char PROGMEM httpd_header_304[] =
+"HTTP/1.1 304 Not Modified\n"
+"Connection: close\n";
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+const char PROGMEM httpd_header_304_keepalive[] =
+"HTTP/1.1 304 Not Modified\n"
+"Connection: keep-alive\n";
+#endif	/* HTTPD_KEEPALIVE_SUPPORT */
+#endif	/* HTTPD_ETAG_SUPPORT */
+
+
 const char PROGMEM httpd_header_400[] =
 "HTTP/1.1 400 Bad Request\n"
 "Connection: close\n"
@@ -80,6 +80,144 @@ httpd_cleanup(void)
 }
 
 
+static void httpd_handle_input(void);
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+/* Check the token of the Connection header, the value is case
+   insensitive. */
+static uint8_t
+httpd_connection_is(const char *headers, PGM_P token)
+{
+  char *value = strstr_P(headers, PSTR("Connection: "));
+  return value && strncasecmp_P(value + 12, token, strlen_P(token)) == 0;
+}
+
+/* Keep what the client sent before the current request has been
+   answered.  Only the next request is kept; if there are more, the
+   connection is closed after answering that one and the client has to
+   send the others again. */
+static void
+httpd_keepalive_stash(char *data, uint16_t len)
+{
+  while (len)
+  {
+    if (STATE->skip)
+    {
+      /* Look for the blank line, it may be split over two segments. */
+      char c = *data++;
+      len--;
+      if (c != pgm_read_byte(PSTR("\r\n\r\n") + STATE->eoh))
+        STATE->eoh = (c == '\r');
+      else if (STATE->eoh < 3)
+        STATE->eoh++;
+      else
+      {
+        STATE->eoh = 0;
+        STATE->skip = 0;
+      }
+      continue;
+    }
+
+    if (STATE->pending_done)
+    {
+      printf("httpd: too many pipelined requests.\n");
+      STATE->requests = HTTPD_KEEPALIVE_REQUESTS - 1;
+      return;
+    }
+
+    uint8_t old = STATE->pending_len;
+    uint8_t n = HTTPD_KEEPALIVE_BUFFER - 1 - old;
+    if (len < n)
+      n = len;
+
+    memcpy(STATE->pending + old, data, n);
+    STATE->pending_len += n;
+    STATE->pending[STATE->pending_len] = 0;
+
+    /* The blank line may be split over two segments. */
+    char *end = strstr_P(STATE->pending + (old > 3 ? old - 3 : 0),
+                         PSTR("\r\n\r\n"));
+    if (end)
+    {
+      uint8_t used = end + 4 - STATE->pending;
+      STATE->pending_len = used;
+      STATE->pending_done = 1;
+      data += used - old;
+      len -= used - old;
+      continue;
+    }
+
+    if (len == n)
+      return;                   /* Wait for the rest of it. */
+
+    /* The request line is all we need, drop the other headers.  Their
+       end may start in the last few bytes kept. */
+    uint8_t back = n < 3 ? n : 3;
+    data += n - back;
+    len -= n - back;
+    STATE->pending_done = 1;
+    STATE->pending_cut = 1;
+    STATE->skip = 1;
+    STATE->eoh = 0;
+  }
+}
+
+/* Start on the request that has been sent ahead, once it is complete. */
+static void
+httpd_keepalive_next(void)
+{
+  if (STATE->handler || !STATE->pending_done)
+    return;
+
+  uint16_t len = uip_len;
+  memcpy(uip_appdata, STATE->pending, STATE->pending_len);
+  uip_len = STATE->pending_len;
+  if (STATE->pending_cut)
+  {
+    memcpy_P((char *) uip_appdata + uip_len, PSTR("\r\n\r\n"), 4);
+    uip_len += 4;
+  }
+
+  STATE->pending_len = 0;
+  STATE->pending_done = 0;
+  STATE->pending_cut = 0;
+  httpd_handle_input();
+  uip_len = len;
+}
+#endif /* HTTPD_KEEPALIVE_SUPPORT */
+
+
+/* The response has been sent completely, close the connection or wait
+   for the next request on it. */
+void
+httpd_done(void)
+{
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+  if (STATE->keepalive)
+  {
+    printf("httpd: keeping connection.\n");
+    httpd_cleanup();
+    STATE->header_acked = 0;
+    STATE->eof = 0;
+    STATE->idle = 0;
+    uip_clear_windowed();
+
+    httpd_keepalive_next();
+    if (STATE->handler)
+    {
+      /* This callback acknowledged the previous response, not the
+         header of the next one. */
+      uip_flags &= ~UIP_ACKDATA;
+      STATE->handler();
+    }
+    return;
+  }
+#endif /* HTTPD_KEEPALIVE_SUPPORT */
+
+  uip_close();
+}
+
+
 static void
 httpd_handle_input(void)
 {
@@ -90,6 +228,11 @@ httpd_handle_input(void)
   if (STATE->header_reparse)
   {
     printf("reparse next part of the header\n");
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* Where this request ends is not tracked here. */
+    STATE->keepalive = 0;
+    STATE->skip = 0;
+#endif
     goto start_auth;
   }
 #endif /* HTTPD_AUTH_SUPPORT */
@@ -129,6 +272,77 @@ httpd_handle_input(void)
 
   *ptr = 0;                     /* Terminate filename. */
 
+#if defined(HTTPD_ETAG_SUPPORT) || defined(HTTPD_KEEPALIVE_SUPPORT)
+  ((char *) uip_appdata)[uip_len] = 0;
+#endif
+
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+  STATE->keepalive = ++STATE->requests < HTTPD_KEEPALIVE_REQUESTS;
+
+  /* Skip the headers, whatever follows them is the next request
+     already. */
+  char *end = strstr_P(ptr + 1, PSTR("\r\n\r\n"));
+  STATE->skip = 1;
+  STATE->eoh = 0;
+  httpd_keepalive_stash(ptr + 1, (char *) uip_appdata + uip_len - (ptr + 1));
+  if (end)
+    end[4] = 0;                 /* Don't look into the next request. */
+
+  /* HTTP/1.1 keeps the connection unless told otherwise, HTTP/1.0 only
+     if asked to. */
+  if (strncmp_P(ptr + 1, PSTR("HTTP/1.1"), 8)
+      ? !httpd_connection_is(ptr + 1, PSTR("keep-alive"))
+      : httpd_connection_is(ptr + 1, PSTR("close")))
+    STATE->keepalive = 0;
+#endif /* HTTPD_KEEPALIVE_SUPPORT */
+
+#ifdef HTTPD_ETAG_SUPPORT
+  /* Look for the entity tag of a cached copy, before the file name
+   * is extended over the headers below. */
+  uint32_t etag = 0;
+  uint8_t if_none_match = 0;
+  char *inm = strstr_P(ptr + 1, PSTR("If-None-Match: \""));
+  if (inm)
+  {
+    char *end;
+    etag = strtoul(inm + 16, &end, 16);
+    if_none_match = (*end == '"');
+  }
+#endif /* HTTPD_ETAG_SUPPORT */
+
+#ifdef HTTPD_RANGE_SUPPORT
+  /* A single byte range, "first-last", "first-" or "-suffix".  Anything
+   * else is ignored and the whole file is sent. */
+  uint8_t range = 0, range_suffix = 0;
+  vfs_size_t range_start = 0, range_end = 0;
+  char *rng = strstr_P(ptr + 1, PSTR("\nRange: bytes="));
+  if (rng)
+  {
+    char *end;
+    rng += 14;
+    if (*rng == '-')
+    {
+      range_suffix = 1;
+      range_start = strtoul(rng + 1, &end, 10);
+      range = end > rng + 1;
+    }
+    else
+    {
+      range_start = strtoul(rng, &end, 10);
+      range = end > rng && *end == '-';
+      rng = end + 1;
+      if (range && *rng >= '0' && *rng <= '9')
+      {
+        range_end = strtoul(rng, &end, 10) + 1;
+        range = range_end > range_start;
+      }
+      else
+        end = rng;
+    }
+    range = range && (*end == '\r' || *end == '\n');
+  }
+#endif /* HTTPD_RANGE_SUPPORT */
+
   /*
    * Successfully parsed the GET request,
    * possibly check authentication.
@@ -265,6 +479,18 @@ after_auth:
     STATE->u.vfs.content_type = *filename;
   }
 
+#ifdef HTTPD_ETAG_SUPPORT
+  STATE->u.vfs.etag = etag;
+  STATE->u.vfs.if_none_match = if_none_match;
+  STATE->u.vfs.page = strstr_P(filename, PSTR(".ht")) != NULL;
+#endif /* HTTPD_ETAG_SUPPORT */
+#ifdef HTTPD_RANGE_SUPPORT
+  STATE->u.vfs.range = range;
+  STATE->u.vfs.range_suffix = range_suffix;
+  STATE->u.vfs.range_start = range_start;
+  STATE->u.vfs.range_end = range_end;
+#endif /* HTTPD_RANGE_SUPPORT */
+
   STATE->u.vfs.fd = vfs_open(filename);
   if (STATE->u.vfs.fd)
   {
@@ -281,6 +507,9 @@ after_auth:
     *(ptr++) = '/';
 
   strcpy_P(ptr, PSTR(HTTPD_INDEX));
+#ifdef HTTPD_ETAG_SUPPORT
+  STATE->u.vfs.page = 1;
+#endif
   STATE->u.vfs.fd = vfs_open(filename);
   if (STATE->u.vfs.fd)
   {
@@ -345,14 +574,47 @@ httpd_main(void)
     STATE->header_reparse = 0;
 #ifdef HTTPD_AUTH_SUPPORT
     STATE->auth_state = PAM_UNKOWN;
+#endif
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    STATE->keepalive = 0;
+    STATE->skip = 0;
+    STATE->eoh = 0;
+    STATE->pending_done = 0;
+    STATE->pending_cut = 0;
+    STATE->requests = 0;
+    STATE->idle = 0;
+    STATE->pending_len = 0;
 #endif
   }
 
   if (uip_newdata() && (!STATE->handler || STATE->header_reparse))
   {
     printf("httpd: new data\n");
-    httpd_handle_input();
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* Collect the request line first, if it comes in pieces. */
+    if (!STATE->header_reparse && (STATE->skip || STATE->pending_len
+                                   || !memchr(uip_appdata, '\n', uip_len)))
+    {
+      httpd_keepalive_stash(uip_appdata, uip_len);
+      httpd_keepalive_next();
+    }
+    else
+#endif
+      httpd_handle_input();
   }
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+  else if (uip_newdata())
+    httpd_keepalive_stash(uip_appdata, uip_len);        /* Busy answering. */
+
+  /* Between requests, polled every 200ms. */
+  if (uip_poll() && !STATE->handler && STATE->requests
+      && ++STATE->idle >= HTTPD_KEEPALIVE_TIMEOUT * 5)
+  {
+    printf("httpd: idle connection closed\n");
+    uip_close();
+    return;
+  }
+#endif
 
 #ifdef HTTPD_AUTH_SUPPORT
   if (STATE->auth_state == PAM_DENIED && STATE->handler != httpd_handle_401)
@@ -37,6 +37,7 @@
 void httpd_init (void);
 void httpd_main (void);
 void httpd_cleanup (void);
+void httpd_done (void);
 
 void httpd_handle_400 (void);
 void httpd_handle_401 (void);
@@ -63,6 +64,13 @@ extern const char httpd_header_ct_xicon[];
 #endif
 
 extern const char httpd_header_ecmd[];
+extern const char httpd_header_304[];
+extern const char httpd_header_200_keepalive[];
+extern const char httpd_header_304_keepalive[];
+extern const char httpd_header_206[];
+extern const char httpd_header_206_keepalive[];
+extern const char httpd_header_416[];
+extern const char httpd_header_ranges[];
 extern const char httpd_header_400[];
 extern const char httpd_header_gzip[];
 extern const char httpd_header_401[];
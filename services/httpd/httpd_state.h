@@ -34,11 +34,37 @@ typedef enum {
 
 #define SD_DIR_MAX_DIRNAME_LEN 75
 
+#if defined(HTTPD_KEEPALIVE_SUPPORT) && HTTPD_KEEPALIVE_BUFFER > 255
+#error "HTTPD_KEEPALIVE_BUFFER must not exceed 255, pending_len is 8 bit"
+#endif
+
 struct httpd_connection_state_t {
     unsigned header_acked		: 1;
     unsigned header_reparse		: 1;
     unsigned eof			: 1;
 
+#ifdef HTTPD_KEEPALIVE_SUPPORT
+    /* Wait for another request once the response is done. */
+    unsigned keepalive			: 1;
+    /* Incoming data is the rest of a header already dealt with, eoh
+     * counts the characters of the blank line seen so far. */
+    unsigned skip			: 1;
+    unsigned eoh			: 2;
+    /* The pipelined request is complete, pending_cut if its headers
+     * didn't fit. */
+    unsigned pending_done		: 1;
+    unsigned pending_cut		: 1;
+
+    uint8_t requests;
+    /* Polls since the last response was done. */
+    uint8_t idle;
+
+    /* The next request, if the client sent it before this one was
+     * answered. */
+    uint8_t pending_len;
+    char pending[HTTPD_KEEPALIVE_BUFFER];
+#endif /* HTTPD_KEEPALIVE_SUPPORT */
+
 #ifdef HTTPD_AUTH_SUPPORT
     uint8_t auth_state;
 #endif /* HTTP_AUTH_SUPPORT */
@@ -56,6 +82,23 @@ struct httpd_connection_state_t {
 	    unsigned char content_type;
 
 	    vfs_size_t acked, sent;
+
+#ifdef HTTPD_ETAG_SUPPORT
+	    /* Entity tag from If-None-Match, if if_none_match is set. */
+	    uint32_t etag;
+	    unsigned if_none_match	: 1;
+	    /* Use the cache lifetime of pages, not of other files. */
+	    unsigned page		: 1;
+#endif	/* HTTPD_ETAG_SUPPORT */
+
+#ifdef HTTPD_RANGE_SUPPORT
+	    /* Byte range to send if range is set, range_end is exclusive
+	       and 0 if open.  With range_suffix, range_start is the
+	       length of the suffix until the file size is known. */
+	    vfs_size_t range_start, range_end;
+	    unsigned range		: 1;
+	    unsigned range_suffix	: 1;
+#endif	/* HTTPD_RANGE_SUPPORT */
 	} vfs;
 #endif	/* VFS_SUPPORT */
 
@@ -88,7 +88,15 @@ tftp_handle_packet(void)
       pk->type = HTONS(3);      /* data packet */
       pk->u.data.block = HTONS(state->transfered + 1);
 
-      fs_size_t ret = vfs_read(state->fh, pk->u.data.data, 512);
+      fs_size_t ret;
+#ifndef VFS_TEENSY
+      if (!VFS_HAVE_FUNC(state->fh, pread))
+        ret = vfs_read(state->fh, pk->u.data.data, 512);
+      else
+#endif
+        /* Copy straight from the file, no matter where it was left. */
+        ret = vfs_pread(state->fh, pk->u.data.data, 512,
+                        (vfs_size_t) state->transfered * 512);
 
       if (ret < 0)
         goto error_out;
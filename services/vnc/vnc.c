@@ -77,9 +77,15 @@ vnc_main(void)
         STATE->state = VNC_STATE_SEND_VERSION;
     }
 
-    if (uip_acked() && STATE->state < VNC_STATE_IDLE)
+    if (uip_acked() && STATE->state < VNC_STATE_IDLE) {
         STATE->state++;
-    else if (uip_acked() && STATE->state == VNC_STATE_UPDATE) {
+        /* Only framebuffer updates follow, these may stream with
+           several segments in flight. */
+        if (STATE->state == VNC_STATE_IDLE)
+          uip_set_windowed();
+    }
+    else if (uip_acked() && STATE->state == VNC_STATE_UPDATE
+             && !uip_windowed(uip_conn)) {
       uint8_t i = 0, x, y;
       while (STATE->updates_sent[i][0] != 0xff && i < VNC_UPDATES_SENT_LENGTH) {
         x = STATE->updates_sent[i][0];
@@ -139,6 +145,8 @@ vnc_main(void)
         uip_send(uip_sappdata, sizeof(server_init)); 
         VNCDEBUG("server init, sent %d bytes\n", sizeof(server_init)); 
       } else if (STATE->state == VNC_STATE_UPDATE) {
+        if (uip_mss() < 4 + sizeof(struct gui_block))
+          return;               /* Window full */
         uint8_t updating_block_count = 
                 (uip_mss() - 4 ) / sizeof(struct gui_block) ;
         /* VNCDEBUG("we are able to update %d blocks at once\n", 
@@ -154,6 +162,10 @@ vnc_main(void)
               STATE->updates_sent[block][0] = x;
               STATE->updates_sent[block][1] = y;
               vnc_make_block(&update->blocks[block], x, y);
+              /* uIP retransmits windowed data itself, no need to
+                 wait for the ACK. */
+              if (uip_windowed(uip_conn))
+                STATE->update_map[y][x / 8] &= ~_BV(x % 8);
               block++;
               if (block == updating_block_count) 
                 goto end_update_block_finder;